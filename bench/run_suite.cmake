@@ -0,0 +1,14 @@
+# NOTE: cmake -P wrapper so the bench target only passes --baseline when the baseline file exists
+set(ARGS --suite ${RESULTS})
+if(EXISTS "${BASELINE}")
+	list(APPEND ARGS --baseline ${BASELINE})
+else()
+	message(STATUS "No benchmark baseline at ${BASELINE}, recording results only")
+endif()
+
+execute_process(COMMAND ${RAY} ${ARGS} RESULT_VARIABLE RESULT)
+if(RESULT EQUAL 2)
+	message(FATAL_ERROR "Benchmark regressions against ${BASELINE}")
+elseif(NOT RESULT EQUAL 0)
+	message(FATAL_ERROR "Benchmark suite failed (${RESULT})")
+endif()
@@ -1,35 +1,77 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <time.h>
-#include <assert.h>
+#include "ray_types.h"
 
-#define RAYS_PER_PIXEL 1024
+#define RAYS_PER_PIXEL 1024 // defaults for scenes that don't set samples / bounces
+#define MAX_BOUNCE_COUNT 8
+#define ROULETTE_START_BOUNCE 5 // NOTE: paths get this many bounces before Russian roulette may end them
+#define MIN_RAYS_PER_PIXEL 16 // NOTE: adaptive sampling never stops a pixel before this
 #define USE_MULTI_THREADING 1 // use multi threading
-#define USE_SIMD 1 // use SSE2 instructions
 
-typedef uint8_t u8;
-typedef uint16_t u16;
-typedef uint32_t u32;
-typedef uint64_t u64;
+// NOTE: host side vector math is scalar, the sample kernels pick their own lane width at runtime
+#define LANE_WIDTH 1
 
-typedef int8_t i8;
-typedef int16_t i16;
-typedef int32_t i32;
-
-typedef float f32;
-typedef double f64;
-
-#define U32_MAX ((u32) - 1)
-
-#include <math.h>
-#include <float.h>
 #include "ray_lane.h"
 #include "ray_math.h"
 #include "ray.h"
-#include "random_gen.h"
+#include "ray_bvh.h"
+#include "ray_cpu.h"
 
+#if defined(_WIN32)
 #include "ray_win32.h"
+#else
+#include "ray_linux.h"
+#endif
+
+#include "ray_work.h"
+#include "ray_world.h"
+#include "ray_packet.h"
+#include "ray_obj.h"
+#include "ray_scene.h"
+#include "ray_cache.h"
+#include "ray_checkpoint.h"
+#include "ray_bench.h"
+#include "ray_suite.h"
+
+struct LaneKernel
+{
+	u32 laneWidth;
+	const char* name;
+	CastSampleRaysFn* castSampleRays;
+	CastBlockRaysFn* castBlockRays;
+};
+
+static LaneKernel laneKernels[] =
+{
+	{ 16, "AVX-512", CastSampleRaysAVX512, CastBlockRaysAVX512 },
+	{ 8, "AVX2", CastSampleRaysAVX2, CastBlockRaysAVX2 },
+	{ 4, "SSE2", CastSampleRaysSSE2, CastBlockRaysSSE2 },
+	{ 1, "scalar", CastSampleRaysScalar, CastBlockRaysScalar },
+};
+
+// NOTE: widest kernel the host supports, capped by the requested width if any
+static LaneKernel* PickLaneKernel(u32 requestedWidth)
+{
+	u32 maxWidth = GetWidestLaneWidth();
+	if (requestedWidth > maxWidth)
+	{
+		fprintf(stderr, "[WARNING] %d-wide lanes are not supported by this CPU, using %d.\n", requestedWidth, maxWidth);
+	}
+	else if (requestedWidth != 0)
+	{
+		maxWidth = requestedWidth;
+	}
+
+	LaneKernel* result = &laneKernels[ARRAY_COUNT(laneKernels) - 1];
+	for (u32 kernelIndex = 0; kernelIndex < ARRAY_COUNT(laneKernels); ++kernelIndex)
+	{
+		if (laneKernels[kernelIndex].laneWidth <= maxWidth)
+		{
+			result = &laneKernels[kernelIndex];
+			break;
+		}
+	}
+
+	return result;
+}
 
 static u32 GetTotalPixelSize(ImageU32 image)
 {
@@ -79,357 +121,1049 @@ static void WriteImage(ImageU32 image, const char* fileName)
 	}
 }
 
+// NOTE: blue for the fewest rays through green and yellow to red at the cap
+static ImageU32 MakeSampleHeatmap(u32* sampleCounts, u32 width, u32 height, u32 maxSampleCount)
+{
+	vec3 ramp[] =
+	{
+		{ 0.0f, 0.0f, 0.5f },
+		{ 0.0f, 0.4f, 1.0f },
+		{ 0.0f, 0.9f, 0.3f },
+		{ 1.0f, 0.9f, 0.0f },
+		{ 1.0f, 0.0f, 0.0f },
+	};
+	u32 segmentCount = ARRAY_COUNT(ramp) - 1;
+
+	ImageU32 result = CreateImage(width, height);
+	for (u64 pixelIndex = 0; pixelIndex < (u64)width * height; ++pixelIndex)
+	{
+		f32 t = Clamp01((f32)sampleCounts[pixelIndex] / (f32)maxSampleCount) * segmentCount;
+		u32 segment = (u32)t;
+		if (segment >= segmentCount)
+		{
+			segment = segmentCount - 1;
+		}
+		vec3 color = Lerp(ramp[segment], ramp[segment + 1], t - (f32)segment);
+
+		result.pixels[pixelIndex] = ((255u << 24) |
+			(RoundF32ToU32(255.0f * color.x) << 16) |
+			(RoundF32ToU32(255.0f * color.y) << 8) |
+			(RoundF32ToU32(255.0f * color.z) << 0));
+	}
+
+	return result;
+}
+
+// NOTE: linear color to the 8-bit sRGB BMP pixel
+static u32 PackPixel(vec3 color)
+{
+	// TODO: real sRGB
+	f32 r = 255.0f * LinearToSRGB255(color.x);
+	f32 g = 255.0f * LinearToSRGB255(color.y);
+	f32 b = 255.0f * LinearToSRGB255(color.z);
+	f32 a = 255.0f;
+
+	u32 result = ((RoundF32ToU32(a) << 24) |
+				  (RoundF32ToU32(r) << 16) |
+				  (RoundF32ToU32(g) << 8) |
+				  (RoundF32ToU32(b) << 0));
+
+	return result;
+}
+
 static u32* GetPixelPointer(ImageU32* image, u32 x, u32 y)
 {
 	u32* result = image->pixels + x + (u64)y * image->width;
 	return result;
 }
 
-static void CastSampleRays(CastState* cast)
+static bool IsPastDeadline(WorkQueue* queue)
 {
-	World* world = cast->world;
-	u32 raysPerPixel = cast->raysPerPixel;
-	u32 maxBounceCount = cast->maxBounceCount;
-	lane_f32 filmX = LaneF32FromF32(cast->filmX + cast->halfPixW);
-	lane_f32 filmY = LaneF32FromF32(cast->filmY + cast->halfPixH);
-	lane_v3 filmCenter = LaneV3FromV3(cast->filmCenter);
-	lane_f32 filmW = LaneF32FromF32(cast->filmW);
-	lane_f32 filmH = LaneF32FromF32(cast->filmH);
-	lane_f32 halfPixW = LaneF32FromF32(cast->halfPixW);
-	lane_f32 halfPixH = LaneF32FromF32(cast->halfPixH);
-	lane_v3 cameraX = LaneV3FromV3(cast->cameraX);
-	lane_v3 cameraY = LaneV3FromV3(cast->cameraY);
-	lane_v3 cameraPos = LaneV3FromV3(cast->cameraPos);
-	RandomSeries* entropy = cast->entropy;
-
-	lane_u32 bounces = LaneU32FromU32(0);
-	lane_v3 color = {};
-
-	u32 laneRayCount = raysPerPixel / LANE_WIDTH;
-	assert(laneRayCount * LANE_WIDTH ==	raysPerPixel);
-
-	f32	contrib = 1.0f / (f32)raysPerPixel;
-	for (u32 rayIndex = 0; rayIndex < laneRayCount; ++rayIndex)
-	{
-		lane_f32 offX = filmX + halfPixW * RandomFloatBi(entropy);
-		lane_f32 offY = filmY + halfPixH * RandomFloatBi(entropy);
-		lane_v3 filmPos = filmCenter + offX * 0.5f * filmW * cameraX + offY * 0.5f * filmH * cameraY;
-
-		lane_v3 rayOrigin = cameraPos;
-		lane_v3 rayDir = VecNormalize(filmPos - cameraPos);
-
-		lane_f32 minHitDist = LaneF32FromF32(0.001f);
-		//NOTE: temporary epsilon
-		lane_f32 epsilon = LaneF32FromF32(0.0001f);
-
-		lane_v3 sample = {};
-		lane_v3 attenuation = Vec3(1.0f, 1.0f, 1.0f);
-
-		lane_u32 laneMask = LaneU32FromU32(0xffffffff);
-
-		for (u32 bounce = 0; bounce < maxBounceCount; ++bounce)
-		{
-			lane_u32 laneIncrement = LaneU32FromU32(1);
-			bounces += (laneIncrement & laneMask);
-
-			lane_f32 hitDist = LaneF32FromF32(FLT_MAX);
-			lane_u32 hitMaterial = LaneU32FromU32(0);
-			lane_v3 nextNormal = {};
-			for (u32 planeIndex = 0; planeIndex < world->planeCount; ++planeIndex)
-			{
-				Plane* plane = &world->planes[planeIndex];
+	bool result = (queue->deadline > 0.0 && GetWallClockSeconds() >= queue->deadline);
+	return result;
+}
 
-				lane_v3 planeN = LaneV3FromV3(plane->normal);
-				lane_f32 planeDist = LaneF32FromF32(plane->dist);
+static void FinishFrame(WorkQueue* queue)
+{
+	queue->frameDone = 1;
+	WakeAllWaiters(&queue->frameDone);
+}
 
-				lane_f32 denom = Dot(planeN, rayDir);
-				lane_u32 denomMask = ((denom < -epsilon) | (denom > epsilon));
-				if (!MaskIsZero(denomMask))
-				{
-					lane_f32 t = (-planeDist - Dot(planeN, rayOrigin)) / denom;
-					lane_u32 tMask = ((t > minHitDist) & (t < hitDist));
-					lane_u32 hitMask = denomMask & tMask;
-					if (!MaskIsZero(hitMask))
-					{
-						lane_u32 planeMatIndex = LaneU32FromU32(plane->matIndex);
-						ConditionalAssign(&hitDist, hitMask, t);
-						ConditionalAssign(&hitMaterial, hitMask, planeMatIndex);
-						ConditionalAssign(&nextNormal, hitMask, planeN);
-					}
-				}
-			}
+static void AccumulatePixel(WorkQueue* queue, u32 x, u32 y, vec3 color, u32 raysCast)
+{
+	u64 pixelIndex = x + (u64)y * queue->image.width;
+	vec3* sum = &queue->accumulation[pixelIndex];
+	f32 rayWeight = (f32)raysCast;
+	sum->x += rayWeight * color.x;
+	sum->y += rayWeight * color.y;
+	sum->z += rayWeight * color.z;
+	queue->sampleCounts[pixelIndex] += raysCast;
+	f32 invSampleCount = 1.0f / (f32)queue->sampleCounts[pixelIndex];
+	*GetPixelPointer(&queue->image, x, y) = PackPixel(invSampleCount * *sum);
+}
 
-			for (u32 sphereIndex = 0; sphereIndex < world->sphereCount; ++sphereIndex)
-			{
-				Sphere* sphere = &world->spheres[sphereIndex];
+static bool RenderTile(WorkQueue* queue, u32 threadIndex)
+{
+	// NOTE: orders still queued are dropped, ResetWorkQueue starts the next frame from scratch
+	if (IsPastDeadline(queue))
+	{
+		FinishFrame(queue);
+		return false;
+	}
 
-				lane_v3 spherePos = LaneV3FromV3(sphere->pos);
-				lane_f32 sphereRadius = LaneF32FromF32(sphere->radius);
+	WorkOrder order;
+	if (!GetNextWorkOrder(queue, threadIndex, &order))
+	{
+		return false;
+	}
+	f64 startSeconds = GetWallClockSeconds();
 
-				lane_v3 sphereRelRayOrigin = rayOrigin - spherePos;
-				lane_f32 a = Dot(rayDir, rayDir);
-				lane_f32 b = 2.0f * Dot(rayDir, sphereRelRayOrigin);
-				lane_f32 c = Dot(sphereRelRayOrigin, sphereRelRayOrigin) - sphereRadius * sphereRadius;
+	ImageU32* image = &queue->image;
+	Camera* camera = &queue->camera;
 
-				lane_f32 d = SquareRoot(b * b - 4.0f * a * c);
+	CastState castState;
 
-				lane_u32 rootMask = d > epsilon;
-				if (!MaskIsZero(rootMask))
-				{
-					lane_f32 denom = 2.0f * a;
-					lane_f32 tp = (-b + d) / denom;
-					lane_f32 tn = (-b - d) / denom;
+	castState.world = queue->world;
+	castState.raysPerPixel = queue->passRaysPerPixel;
+	castState.maxBounceCount = queue->maxBounceCount;
+	castState.rouletteStartBounce = queue->rouletteStartBounce;
+	castState.adaptiveThreshold = queue->adaptiveThreshold;
+	castState.minRaysPerPixel = queue->minRaysPerPixel;
+	castState.firstSampleIndex = queue->firstSampleIndex;
+	castState.samplerKind = queue->samplerKind;
+	u64 raysCast = 0;
+
+	castState.cameraPos = camera->pos;
+	castState.cameraZ = camera->z;
+	castState.cameraX = camera->x;
+	castState.cameraY = camera->y;
+
+	castState.filmW = camera->filmW;
+	castState.filmH = camera->filmH;
+	castState.filmCenter = camera->filmCenter;
 
-					lane_f32 t = tp;
-					lane_u32 pickMask = (tn > minHitDist) & (tn < tp);
-					ConditionalAssign(&t, pickMask, tn);
+	castState.halfPixW = 0.5f / image->width;
+	castState.halfPixH = 0.5f / image->height;
+	castState.imageWidth = image->width;
+	castState.imageHeight = image->height;
+	castState.stream = queue->streams ? &queue->streams[threadIndex] : 0;
+	castState.packet = queue->packets ? &queue->packets[threadIndex] : 0;
 
-					lane_u32 tMask = (t > minHitDist) & (t < hitDist);
-					lane_u32 hitMask = rootMask & tMask;
-					if (!MaskIsZero(hitMask))
+	castState.bouncesComputed = 0;
+	castState.laneSlotsComputed = 0;
+	u64 orderPixelCount = 0;
+	bool pastDeadline = false;
+	for (u32 blockY = order.minY; blockY < order.maxY && !pastDeadline; blockY += TILE_BLOCK_SIZE)
+	{
+		for (u32 blockX = order.minX; blockX < order.maxX; blockX += TILE_BLOCK_SIZE)
+		{
+			// NOTE: a budgeted frame overshoots its deadline by at most one block
+			pastDeadline = IsPastDeadline(queue);
+			if (pastDeadline)
+			{
+				break;
+			}
+
+			u32 xMax = MinU32(blockX + TILE_BLOCK_SIZE, order.maxX);
+			u32 yMax = MinU32(blockY + TILE_BLOCK_SIZE, order.maxY);
+			if (castState.packet)
+			{
+				BuildRayPacket(castState.packet, queue->world, camera, image->width, image->height, blockX, xMax, blockY, yMax);
+			}
+			if (queue->castBlockRays)
+			{
+				castState.blockMinX = blockX;
+				castState.blockMaxX = xMax;
+				castState.blockMinY = blockY;
+				castState.blockMaxY = yMax;
+
+				RayStream* stream = castState.stream;
+				u32 pixelSlot = 0;
+				for (u32 y = blockY; y < yMax; ++y)
+				{
+					for (u32 x = blockX; x < xMax; ++x, ++pixelSlot)
 					{
-						lane_u32 sphereMatIndex = LaneU32FromU32(sphere->matIndex);
-						ConditionalAssign(&hitDist, hitMask, t);
-						ConditionalAssign(&hitMaterial, hitMask, sphereMatIndex);
-						ConditionalAssign(&nextNormal, hitMask, VecNormalize(t * rayDir + sphereRelRayOrigin));
+						u64 pixelIndex = x + (u64)y * image->width;
+						stream->priorRayCount[pixelSlot] = queue->sampleCounts[pixelIndex];
+						stream->luminanceSum[pixelSlot] = queue->luminanceSums[pixelIndex];
+						stream->luminanceSqSum[pixelSlot] = queue->luminanceSqSums[pixelIndex];
+						stream->converged[pixelSlot] = queue->converged[pixelIndex];
 					}
 				}
-			}
-
-			lane_v3 emitColor = laneMask & GATHER_V3(world->materials, hitMaterial, emitColor); // NOTE: must return 0 on laneMask
-			lane_v3 reflectColor = GATHER_V3(world->materials, hitMaterial, reflectColor);
-			lane_f32 matSpecular = GATHER_F32(world->materials, hitMaterial, specular);
 
-			sample += Hadamard(attenuation, emitColor);
-			laneMask &= (hitMaterial != LaneU32FromU32(0)); // NOTE: disable the dead ray
+				queue->castBlockRays(&castState);
+				raysCast += castState.raysCast;
 
-			if (MaskIsZero(laneMask)) // NOTE: all rays are dead
+				pixelSlot = 0;
+				for (u32 y = blockY; y < yMax; ++y)
+				{
+					for (u32 x = blockX; x < xMax; ++x, ++pixelSlot)
+					{
+						u64 pixelIndex = x + (u64)y * image->width;
+						queue->luminanceSums[pixelIndex] = stream->luminanceSum[pixelSlot];
+						queue->luminanceSqSums[pixelIndex] = stream->luminanceSqSum[pixelSlot];
+						queue->converged[pixelIndex] = stream->converged[pixelSlot];
+						if (stream->pixelRayCount[pixelSlot])
+						{
+							AccumulatePixel(queue, x, y, stream->pixelColor[pixelSlot], stream->pixelRayCount[pixelSlot]);
+						}
+					}
+				}
+			}
+			else
 			{
-				break;
+				for (u32 y = blockY; y < yMax; ++y)
+				{
+					castState.filmY = -1.0f + 2.0f * ((f32)y / (f32)image->height);
+					for (u32 x = blockX; x < xMax; ++x)
+					{
+						castState.filmX = -1.0f + 2.0f * ((f32)x / (f32)image->width);
+						castState.pixelIndex = (u32)(x + (u64)y * image->width);
+
+						// NOTE: adaptive sampling stopped this pixel in an earlier pass
+						u32 pixelIndex = castState.pixelIndex;
+						if (queue->converged[pixelIndex])
+						{
+							continue;
+						}
+						castState.priorRayCount = queue->sampleCounts[pixelIndex];
+						castState.luminanceSum = queue->luminanceSums[pixelIndex];
+						castState.luminanceSqSum = queue->luminanceSqSums[pixelIndex];
+
+						queue->castSampleRays(&castState);
+						raysCast += castState.raysCast;
+						queue->luminanceSums[pixelIndex] = castState.luminanceSum;
+						queue->luminanceSqSums[pixelIndex] = castState.luminanceSqSum;
+						queue->converged[pixelIndex] = castState.converged;
+						AccumulatePixel(queue, x, y, castState.finalColor, castState.raysCast);
+					}
+				}
 			}
-
-			lane_f32 cosAtten = Max(Dot(-rayDir, nextNormal), LaneF32FromF32(0.0f));
-			attenuation = Hadamard(attenuation, cosAtten * reflectColor);
-
-			rayOrigin += hitDist * rayDir;
-			// TODO: reflection
-			lane_v3 reflectedRay = rayDir - 2 * Dot(rayDir, nextNormal) * nextNormal;
-			lane_v3 randomBounce = VecNormalize(nextNormal + LaneV3(RandomFloatBi(entropy), RandomFloatBi(entropy), RandomFloatBi(entropy)));
-			rayDir = VecNormalize(Lerp(randomBounce, reflectedRay, matSpecular));
+			orderPixelCount += (u64)(xMax - blockX) * (yMax - blockY);
 		}
+	}
+
+	WorkThreadStats* stats = &queue->threadStats[threadIndex];
+	++stats->tileCount;
+	stats->busySeconds += GetWallClockSeconds() - startSeconds;
 
-		color += contrib * sample;
+	LockedAdd(&queue->totalRays, raysCast);
+	LockedAdd(&queue->totalBounces, castState.bouncesComputed);
+	LockedAdd(&queue->totalLaneSlots, castState.laneSlotsComputed);
+	if (LockedAdd(&queue->pixelCount, orderPixelCount) + orderPixelCount == queue->pixelTotal)
+	{
+		FinishFrame(queue);
 	}
 
-	cast->bouncesComputed += HorizontalAdd(bounces);
-	cast->finalColor = HorizontalAdd(color);
-	cast->entropy = entropy;
+	return true;
 }
 
-static bool RenderTile(WorkQueue* queue)
+// NOTE: how often a waiting main thread wakes up to report progress
+#define PROGRESS_INTERVAL_MS 100
+
+// NOTE: the calling thread works the first deque, then sleeps until the last tile is in and joins the workers
+static void RenderFrame(WorkQueue* queue, RenderProgressFn* progress, void* progressData)
 {
-	u64 workOrderIndex = LockedAdd(&queue->NextWorkOrderIndex, 1);
-	if (workOrderIndex >= queue->workOrderCount)
+	u32 threadCount = queue->threadCount;
+	WorkThread* threads = (WorkThread*)malloc(sizeof(WorkThread) * threadCount);
+	ThreadHandle* handles = (ThreadHandle*)malloc(sizeof(ThreadHandle) * threadCount);
+	bool* started = (bool*)malloc(sizeof(bool) * threadCount);
+
+	ResetWorkQueue(queue);
+	queue->totalRays = 0;
+	queue->totalBounces = 0;
+	queue->totalLaneSlots = 0;
+	queue->pixelCount = 0;
+	queue->pixelTotal = (u64)queue->image.width * queue->image.height;
+	queue->frameDone = 0;
+
+	// NOTE: For fencing
+	LockedAdd(&queue->pendingOrderCount, 0);
+
+	for (u32 threadIndex = 1; threadIndex < threadCount; ++threadIndex)
 	{
-		return false;
+		threads[threadIndex].queue = queue;
+		threads[threadIndex].threadIndex = threadIndex;
+		started[threadIndex] = CreateThread(&handles[threadIndex], &threads[threadIndex]);
 	}
 
-	WorkOrder* order = &queue->workOrders[workOrderIndex];
+	while (RenderTile(queue, 0))
+	{
+		if (progress)
+		{
+			progress(queue->pixelCount, queue->pixelTotal, progressData);
+		}
+	}
 
-	ImageU32* image = &order->image;
+	while (!queue->frameDone)
+	{
+		WaitOnValue(&queue->frameDone, 0, PROGRESS_INTERVAL_MS);
+		if (progress)
+		{
+			progress(queue->pixelCount, queue->pixelTotal, progressData);
+		}
+	}
 
-	u32 xMin = order->minX;
-	u32 xMax = order->maxX;
-	u32 yMin = order->minY;
-	u32 yMax = order->maxY;
-	f32 filmDist = 1.0f;
+	for (u32 threadIndex = 1; threadIndex < threadCount; ++threadIndex)
+	{
+		if (started[threadIndex])
+		{
+			JoinThread(handles[threadIndex]);
+		}
+	}
 
-	lane_v3 cameraPos = Vec3(0, -10, 1);
-	lane_v3 cameraZ = VecNormalize(cameraPos);
-	lane_v3 cameraX = VecNormalize(Cross(Vec3(0, 0, 1), cameraZ));
-	lane_v3 cameraY = VecNormalize(Cross(cameraZ, cameraX));
-	lane_v3 filmCenter = cameraPos - filmDist * cameraZ;
+	free(started);
+	free(handles);
+	free(threads);
+}
 
-	CastState castState;
+// NOTE: only needed when the accumulation didn't come from RenderTile, it resolves as it goes
+static void ResolveImage(WorkQueue* queue)
+{
+	u64 pixelTotal = (u64)queue->image.width * queue->image.height;
+	for (u64 pixelIndex = 0; pixelIndex < pixelTotal; ++pixelIndex)
+	{
+		u32 sampleCount = queue->sampleCounts[pixelIndex];
+		vec3 color = {};
+		if (sampleCount)
+		{
+			color = (1.0f / (f32)sampleCount) * queue->accumulation[pixelIndex];
+		}
+		queue->image.pixels[pixelIndex] = PackPixel(color);
+	}
+}
 
-	castState.world = order->world;
-	castState.raysPerPixel = queue->raysPerPixel;
-	castState.maxBounceCount = queue->maxBounceCount;
-	castState.entropy = &order->entropy;
+// NOTE: the image goes black too, pixels a budgeted first pass never reaches stay that way
+static void ClearAccumulation(WorkQueue* queue)
+{
+	u64 pixelTotal = (u64)queue->image.width * queue->image.height;
+	memset(queue->accumulation, 0, sizeof(vec3) * pixelTotal);
+	memset(queue->sampleCounts, 0, sizeof(u32) * pixelTotal);
+	memset(queue->luminanceSums, 0, sizeof(f32) * pixelTotal);
+	memset(queue->luminanceSqSums, 0, sizeof(f32) * pixelTotal);
+	memset(queue->converged, 0, sizeof(u8) * pixelTotal);
+	for (u64 pixelIndex = 0; pixelIndex < pixelTotal; ++pixelIndex)
+	{
+		queue->image.pixels[pixelIndex] = 0xFF000000;
+	}
+}
 
-	castState.cameraPos = Extract0(cameraPos);
-	castState.cameraZ = Extract0(cameraZ);
-	castState.cameraX = Extract0(cameraX);
-	castState.cameraY = Extract0(cameraY);
+struct ProgressiveSettings
+{
+	u32 passRaysPerPixel;
+	f64 budgetSeconds; // NOTE: 0 runs every pass
+	const char* snapshotFileName; // NOTE: optional, rewritten after every pass
+	const char* checkpointFileName; // NOTE: optional, written after a whole pass once the interval is up
+	const char* resumeFileName;
+	f64 checkpointSeconds;
+	u32 laneWidth;
+};
+
+// NOTE: renders raysPerPixel in passes of passRaysPerPixel over the whole image, so a stopped job still
+// leaves the last snapshot or checkpoint behind. With a budget the passes stop at the deadline, mid-pass
+// if need be, and keep whatever they accumulated.
+static bool RenderProgressive(WorkQueue* queue, ProgressiveSettings* settings)
+{
+	u32 passRaysPerPixel = settings->passRaysPerPixel;
+	CheckpointHeader checkpoint = {};
+	if (settings->checkpointFileName || settings->resumeFileName)
+	{
+		checkpoint = MakeCheckpointHeader(queue, settings->laneWidth, passRaysPerPixel);
+	}
 
-	castState.filmW = 1.0f;
-	castState.filmH = 1.0f;
-	if (image->width > image->height)
+	if (settings->resumeFileName)
 	{
-		castState.filmH = castState.filmW * ((f32)image->height / (f32)image->width);
+		if (!LoadCheckpoint(queue, &checkpoint, settings->resumeFileName))
+		{
+			return false;
+		}
+		ResolveImage(queue);
+		printf("Resumed %s after %d passes, %d rays per pixel\n", settings->resumeFileName,
+			checkpoint.passCount, checkpoint.raysPerPixelDone);
 	}
-	else if (image->height > image->width)
+	else
 	{
-		castState.filmW = castState.filmH * ((f32)image->width / (f32)image->height);
+		ClearAccumulation(queue);
 	}
-	castState.filmCenter = Extract0(filmCenter);
 
-	castState.halfPixW = 0.5f / image->width;
-	castState.halfPixH = 0.5f / image->height;
+	u64 totalRays = 0;
+	u64 totalBounces = 0;
+	u64 totalLaneSlots = 0;
+	u32 raysPerPixelDone = checkpoint.raysPerPixelDone;
+	u32 firstPassIndex = checkpoint.passCount;
+	u32 passCount = firstPassIndex;
+	if (queue->raysPerPixel > raysPerPixelDone)
+	{
+		passCount += (queue->raysPerPixel - raysPerPixelDone + passRaysPerPixel - 1) / passRaysPerPixel;
+	}
 
-	castState.bouncesComputed = 0;
-	for (u32 y = yMin; y < yMax; ++y)
+	f64 startSeconds = GetWallClockSeconds();
+	f64 checkpointSeconds = startSeconds;
+	queue->deadline = (settings->budgetSeconds > 0.0) ? startSeconds + settings->budgetSeconds : 0.0;
+	for (u32 passIndex = firstPassIndex; passIndex < passCount; ++passIndex)
 	{
-		u32* out =  GetPixelPointer(image, xMin, y);
+		queue->firstSampleIndex = raysPerPixelDone;
+		queue->passRaysPerPixel = MinU32(passRaysPerPixel, queue->raysPerPixel - raysPerPixelDone);
+		RenderFrame(queue, 0, 0);
+
+		totalRays += queue->totalRays;
+		totalBounces += queue->totalBounces;
+		totalLaneSlots += queue->totalLaneSlots;
 
-		castState.filmY = -1.0f + 2.0f * ((f32)y / (f32)image->height);
-		for (u32 x = xMin; x < xMax; ++x)
+		if (settings->snapshotFileName)
 		{
-			castState.filmX = -1.0f + 2.0f * ((f32)x / (f32)image->width);
-			
-			CastSampleRays(&castState);
+			WriteImage(queue->image, settings->snapshotFileName);
+		}
 
-			// TODO: real sRGB
-			f32 r = 255.0f * LinearToSRGB255(castState.finalColor.x);
-			f32 g = 255.0f * LinearToSRGB255(castState.finalColor.y);
-			f32 b = 255.0f * LinearToSRGB255(castState.finalColor.z);
-			f32 a = 255.0f;
+		f64 seconds = GetWallClockSeconds() - startSeconds;
+		if (queue->pixelCount < queue->pixelTotal)
+		{
+			// NOTE: the accumulation now holds part of a pass, checkpoints only ever get whole ones
+			printf("Pass %d/%d: stopped at the deadline with %.0f%% of the pass done, %.3f s\n", passIndex + 1, passCount,
+				100.0 * queue->pixelCount / queue->pixelTotal, seconds);
+			break;
+		}
+
+		raysPerPixelDone += queue->passRaysPerPixel;
+		printf("Pass %d/%d: %d rays per pixel, %.3f s\n", passIndex + 1, passCount, raysPerPixelDone, seconds);
 
-			u32 bmpValue = ((RoundF32ToU32(a) << 24) |
-							(RoundF32ToU32(r) << 16) |
-							(RoundF32ToU32(g) << 8) |
-							(RoundF32ToU32(b) << 0));
-			*out++ = bmpValue; // y < 32 ? 0xFF00CCEE : 0xFF6600EE;
+		f64 nowSeconds = GetWallClockSeconds();
+		if (settings->checkpointFileName &&
+			(nowSeconds - checkpointSeconds >= settings->checkpointSeconds || passIndex + 1 == passCount))
+		{
+			checkpoint.passCount = passIndex + 1;
+			checkpoint.raysPerPixelDone = raysPerPixelDone;
+			if (WriteCheckpoint(queue, &checkpoint, settings->checkpointFileName))
+			{
+				printf("Wrote checkpoint %s\n", settings->checkpointFileName);
+			}
+			checkpointSeconds = nowSeconds;
 		}
+		fflush(stdout);
 	}
 
-	LockedAdd(&queue->totalBounces, castState.bouncesComputed);
-	LockedAdd(&queue->tileCount, 1);
+	// NOTE: totals over the passes of this run, for the caller's report
+	queue->totalRays = totalRays;
+	queue->totalBounces = totalBounces;
+	queue->totalLaneSlots = totalLaneSlots;
+	queue->pixelCount = queue->pixelTotal;
+	queue->deadline = 0.0;
+	queue->firstSampleIndex = 0;
+	queue->passRaysPerPixel = queue->raysPerPixel;
 
 	return true;
 }
 
-int main(int argc, char** argv)
+static void PrintProgress(u64 pixelCount, u64 pixelTotal, void* data)
 {
-	Material materials[7] =
-	{
-		//{ {0.5f, 0.8f, 1.0f}, { }, 0.0f },
-		{ {0.01f, 0.01f, 0.01f}, { }, 0.0f },
-		{ { }, {0.6f, 0.6f, 0.6f}, 0.0f },
-		{ { }, {0.5f, 0.5f, 1.0f}, 0.0f },
-		{ {40.0f, 10.0f, 1.0f}, { }, 0.0f },
-		{ { }, {0.1f, 1.0f, 0.8f}, 1.0f },
-		{ { }, {0.5f, 0.2f, 0.9f}, 0.85f },
-		{ { }, {0.99f, 0.99f, 0.99f}, 1.0f },
-	};
+	printf("\rRaycasting %d%%...   ", (u32)(100 * pixelCount / pixelTotal));
+	fflush(stdout);
+}
 
-	Plane planes[] =
+// NOTE: the kernel casts whole lanes of rays per pixel
+static void RoundRaysPerPixel(Scene* scene, LaneKernel* kernel)
+{
+	u32 laneRayCount = (scene->raysPerPixel + kernel->laneWidth - 1) / kernel->laneWidth;
+	if (laneRayCount == 0)
 	{
-		{{0, 0, 1}, 0, 1 },
-	};
+		laneRayCount = 1;
+	}
+	if (laneRayCount * kernel->laneWidth != scene->raysPerPixel)
+	{
+		fprintf(stderr, "[WARNING] %d rays per pixel rounded up to %d for %d-wide lanes.\n",
+			scene->raysPerPixel, laneRayCount * kernel->laneWidth, kernel->laneWidth);
+		scene->raysPerPixel = laneRayCount * kernel->laneWidth;
+	}
+}
+
+// NOTE: a wave is at most every pixel of a block times the widest lane
+#define WAVEFRONT_RAY_CAPACITY (TILE_BLOCK_SIZE * TILE_BLOCK_SIZE * MAX_LANE_WIDTH)
 
-	Sphere spheres[] =
+static void AllocateRayStreamSoA(RayStreamSoA* rays, u32 capacity)
+{
+	rays->originX = (f32*)calloc(capacity, sizeof(f32));
+	rays->originY = (f32*)calloc(capacity, sizeof(f32));
+	rays->originZ = (f32*)calloc(capacity, sizeof(f32));
+	rays->dirX = (f32*)calloc(capacity, sizeof(f32));
+	rays->dirY = (f32*)calloc(capacity, sizeof(f32));
+	rays->dirZ = (f32*)calloc(capacity, sizeof(f32));
+	rays->attenuationX = (f32*)calloc(capacity, sizeof(f32));
+	rays->attenuationY = (f32*)calloc(capacity, sizeof(f32));
+	rays->attenuationZ = (f32*)calloc(capacity, sizeof(f32));
+	rays->sampleX = (f32*)calloc(capacity, sizeof(f32));
+	rays->sampleY = (f32*)calloc(capacity, sizeof(f32));
+	rays->sampleZ = (f32*)calloc(capacity, sizeof(f32));
+	rays->scatterPdf = (f32*)calloc(capacity, sizeof(f32));
+	rays->scatterMisMask = (u32*)calloc(capacity, sizeof(u32));
+	rays->pixelSeed = (u32*)calloc(capacity, sizeof(u32));
+	rays->reversedSampleIndex = (u32*)calloc(capacity, sizeof(u32));
+	rays->randomState = (u32*)calloc(capacity, sizeof(u32));
+	rays->pathIndex = (u32*)calloc(capacity, sizeof(u32));
+	rays->hitDist = (f32*)calloc(capacity, sizeof(f32));
+	rays->hitMaterial = (u32*)calloc(capacity, sizeof(u32));
+	rays->normalX = (f32*)calloc(capacity, sizeof(f32));
+	rays->normalY = (f32*)calloc(capacity, sizeof(f32));
+	rays->normalZ = (f32*)calloc(capacity, sizeof(f32));
+}
+
+static void AllocateRayStream(RayStream* stream)
+{
+	u32 capacity = WAVEFRONT_RAY_CAPACITY;
+	u32 blockPixelCount = TILE_BLOCK_SIZE * TILE_BLOCK_SIZE;
+
+	stream->capacity = capacity;
+	stream->regionSize = capacity + MAX_LANE_WIDTH;
+	AllocateRayStreamSoA(&stream->rays, 2 * stream->regionSize);
+	AllocateRayStreamSoA(&stream->sorted, 2 * stream->regionSize);
+	stream->pathColor = (vec3*)calloc(capacity, sizeof(vec3));
+	stream->pathPixel = (u32*)calloc(capacity, sizeof(u32));
+	stream->activePixels = (u32*)calloc(blockPixelCount, sizeof(u32));
+	stream->priorRayCount = (u32*)calloc(blockPixelCount, sizeof(u32));
+	stream->luminanceSum = (f32*)calloc(blockPixelCount, sizeof(f32));
+	stream->luminanceSqSum = (f32*)calloc(blockPixelCount, sizeof(f32));
+	stream->converged = (u8*)calloc(blockPixelCount, sizeof(u8));
+	stream->pixelColor = (vec3*)calloc(blockPixelCount, sizeof(vec3));
+	stream->pixelRayCount = (u32*)calloc(blockPixelCount, sizeof(u32));
+}
+
+static void FreeRayStreamSoA(RayStreamSoA* rays)
+{
+	free(rays->originX);
+	free(rays->originY);
+	free(rays->originZ);
+	free(rays->dirX);
+	free(rays->dirY);
+	free(rays->dirZ);
+	free(rays->attenuationX);
+	free(rays->attenuationY);
+	free(rays->attenuationZ);
+	free(rays->sampleX);
+	free(rays->sampleY);
+	free(rays->sampleZ);
+	free(rays->scatterPdf);
+	free(rays->scatterMisMask);
+	free(rays->pixelSeed);
+	free(rays->reversedSampleIndex);
+	free(rays->randomState);
+	free(rays->pathIndex);
+	free(rays->hitDist);
+	free(rays->hitMaterial);
+	free(rays->normalX);
+	free(rays->normalY);
+	free(rays->normalZ);
+}
+
+static void FreeRayStream(RayStream* stream)
+{
+	FreeRayStreamSoA(&stream->rays);
+	FreeRayStreamSoA(&stream->sorted);
+	free(stream->pathColor);
+	free(stream->pathPixel);
+	free(stream->activePixels);
+	free(stream->priorRayCount);
+	free(stream->luminanceSum);
+	free(stream->luminanceSqSum);
+	free(stream->converged);
+	free(stream->pixelColor);
+	free(stream->pixelRayCount);
+}
+
+static void InitRenderQueue(WorkQueue* queue, Scene* scene, ImageU32 image, LaneKernel* kernel, u32 threadCount, bool wavefront)
+{
+	*queue = {};
+	queue->world = &scene->world;
+	queue->image = image;
+	queue->raysPerPixel = scene->raysPerPixel;
+	queue->passRaysPerPixel = scene->raysPerPixel;
+	queue->maxBounceCount = scene->maxBounceCount;
+	queue->rouletteStartBounce = scene->rouletteStartBounce;
+	queue->adaptiveThreshold = scene->adaptiveThreshold;
+	queue->minRaysPerPixel = scene->minRaysPerPixel;
+	queue->samplerKind = scene->samplerKind;
+	queue->camera = MakeCamera(scene->cameraPos, scene->cameraTarget, image.width, image.height);
+	queue->castSampleRays = kernel->castSampleRays;
+	if (wavefront)
 	{
-		{{0.0f, -1.0f, 0.0f}, 1.0f, 2},
-		{{3.0f, -2.0f, 0.0f}, 1.0f, 3},
-		{{-2.0f, -1.0f, 2.0f}, 1.0f, 4},
-		{{1.0f, -1.0f, 2.5f}, 1.0f, 5},
-		{{-3.0f, 5.0f, 0.0f}, 3.0f, 6},
-	};
+		queue->castBlockRays = kernel->castBlockRays;
+		queue->streams = (RayStream*)calloc(threadCount, sizeof(RayStream));
+		for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+		{
+			AllocateRayStream(&queue->streams[threadIndex]);
+		}
+	}
+	queue->packets = (RayPacket*)calloc(threadCount, sizeof(RayPacket));
+	for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+	{
+		AllocateRayPacket(&queue->packets[threadIndex], &scene->world);
+	}
+	queue->accumulation = (vec3*)calloc((size_t)image.width * image.height, sizeof(vec3));
+	queue->sampleCounts = (u32*)calloc((size_t)image.width * image.height, sizeof(u32));
+	queue->luminanceSums = (f32*)calloc((size_t)image.width * image.height, sizeof(f32));
+	queue->luminanceSqSums = (f32*)calloc((size_t)image.width * image.height, sizeof(f32));
+	queue->converged = (u8*)calloc((size_t)image.width * image.height, sizeof(u8));
+	InitWorkQueue(queue, threadCount);
+}
+
+static void FreeRenderQueue(WorkQueue* queue)
+{
+	if (queue->streams)
+	{
+		for (u32 threadIndex = 0; threadIndex < queue->threadCount; ++threadIndex)
+		{
+			FreeRayStream(&queue->streams[threadIndex]);
+		}
+		free(queue->streams);
+	}
+	for (u32 threadIndex = 0; threadIndex < queue->threadCount; ++threadIndex)
+	{
+		FreeRayPacket(&queue->packets[threadIndex]);
+	}
+	free(queue->packets);
+	free(queue->accumulation);
+	free(queue->sampleCounts);
+	free(queue->luminanceSums);
+	free(queue->luminanceSqSums);
+	free(queue->converged);
+	FreeWorkQueue(queue);
+}
 
-	World world = {};
-	world.materialCount = ARRAY_COUNT(materials);
-	world.materials = materials;
-	world.planeCount = ARRAY_COUNT(planes);
-	world.planes = planes;
-	world.sphereCount = ARRAY_COUNT(spheres);
-	world.spheres = spheres;
+// NOTE: returns the process exit code, 2 when a scene regressed against the baseline
+static int RunBenchmarkSuite(LaneKernel* kernel, u32 threadCount, bool wavefront, BenchmarkSettings* bench,
+	const char* resultsFileName, const char* baselineFileName, f64 tolerance)
+{
+	char* baseline = 0;
+	if (baselineFileName)
+	{
+		baseline = ReadEntireFile(baselineFileName).contents;
+		if (!baseline)
+		{
+			fprintf(stderr, "[ERROR] Unable to read benchmark baseline %s.\n", baselineFileName);
+			return 1;
+		}
+	}
 
-	ImageU32 image = CreateImage(1920, 1080);
+	u32 sceneCount = ARRAY_COUNT(suiteScenes);
+	BenchmarkResult* results = (BenchmarkResult*)calloc(sceneCount, sizeof(BenchmarkResult));
+	for (u32 sceneIndex = 0; sceneIndex < sceneCount; ++sceneIndex)
+	{
+		SuiteScene* suiteScene = &suiteScenes[sceneIndex];
+		Scene scene;
+		GenerateSuiteScene(&scene, suiteScene);
+		RoundRaysPerPixel(&scene, kernel);
+		PrepareWorld(&scene.world, kernel->laneWidth);
+
+		ImageU32 image = CreateImage(scene.imageWidth, scene.imageHeight);
+		WorkQueue queue;
+		InitRenderQueue(&queue, &scene, image, kernel, threadCount, wavefront);
+
+		BenchmarkResult* result = &results[sceneIndex];
+		result->sceneName = suiteScene->name;
+		result->kernelName = kernel->name;
+		result->laneWidth = kernel->laneWidth;
+		RunBenchmark(&queue, bench, result);
+		PrintBenchmarkResult(result);
+
+		// NOTE: the next scene, the million spheres one among them, shouldn't be measured on top of this one
+		FreeRenderQueue(&queue);
+		free(image.pixels);
+		FreeWorld(&scene.world);
+		free(scene.outputFileName);
+	}
+
+	if (!WriteSuiteResults(results, sceneCount, resultsFileName))
+	{
+		return 1;
+	}
+	printf("Wrote benchmark results %s\n", resultsFileName);
+
+	if (baseline && !CheckSuiteBaseline(results, sceneCount, baseline, baselineFileName))
+	{
+		return 1;
+	}
+
+	u32 regressionCount = CompareSuiteResults(results, sceneCount, baseline, tolerance);
+	if (regressionCount)
+	{
+		printf("%d of %d scenes regressed by more than %.1f%%\n", regressionCount, sceneCount, tolerance);
+	}
+
+	for (u32 sceneIndex = 0; sceneIndex < sceneCount; ++sceneIndex)
+	{
+		free(results[sceneIndex].threadStats);
+	}
+	free(results);
+	free(baseline);
+
+	return regressionCount ? 2 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	u32 requestedLaneWidth = 0;
+	const char* sceneFileName = 0;
+	// NOTE: zero / null keeps whatever the scene says
+	u32 width = 0;
+	u32 height = 0;
+	u32 raysPerPixel = 0;
+	i32 maxBounceCount = -1;
+	i32 rouletteStartBounce = -1;
+	const char* outputFileName = 0;
+	const char* cacheFileName = 0;
+	const char* heatmapFileName = 0;
+	f32 adaptiveThreshold = -1.0f;
+	u32 minRaysPerPixel = 0;
+	u32 passRaysPerPixel = 0;
+	i32 samplerKind = -1;
+	f64 budgetSeconds = 0.0;
+	const char* checkpointFileName = 0;
+	const char* resumeFileName = 0;
+	f64 checkpointSeconds = CHECKPOINT_INTERVAL_SECONDS;
+	u32 threadCount = 0;
+	bool wavefront = false;
+	BenchmarkSettings bench = {};
+	bench.warmupCount = 1;
+	const char* suiteFileName = 0;
+	const char* baselineFileName = 0;
+	f64 tolerance = SUITE_DEFAULT_TOLERANCE;
+	for (int argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		const char* arg = argv[argIndex];
+		const char* value = (argIndex + 1 < argc) ? argv[argIndex + 1] : 0;
+		if (value && strcmp(arg, "--lanes") == 0)
+		{
+			requestedLaneWidth = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--scene") == 0)
+		{
+			sceneFileName = value;
+		}
+		else if (value && strcmp(arg, "--width") == 0)
+		{
+			width = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--height") == 0)
+		{
+			height = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--spp") == 0)
+		{
+			raysPerPixel = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--bounces") == 0)
+		{
+			maxBounceCount = atoi(value);
+		}
+		else if (value && strcmp(arg, "--roulette") == 0)
+		{
+			rouletteStartBounce = atoi(value);
+		}
+		else if (value && strcmp(arg, "--output") == 0)
+		{
+			outputFileName = value;
+		}
+		else if (value && strcmp(arg, "--adaptive") == 0)
+		{
+			adaptiveThreshold = (f32)atof(value);
+		}
+		else if (value && strcmp(arg, "--min-spp") == 0)
+		{
+			minRaysPerPixel = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--spp-heatmap") == 0)
+		{
+			heatmapFileName = value;
+		}
+		else if (value && strcmp(arg, "--sampler") == 0)
+		{
+			samplerKind = ParseSamplerKind(value);
+			if (samplerKind < 0)
+			{
+				fprintf(stderr, "[ERROR] Unknown sampler %s, expected random or sobol.\n", value);
+				return 1;
+			}
+		}
+		else if (value && strcmp(arg, "--progressive") == 0)
+		{
+			passRaysPerPixel = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--time-budget") == 0)
+		{
+			budgetSeconds = atof(value);
+		}
+		else if (value && strcmp(arg, "--checkpoint") == 0)
+		{
+			checkpointFileName = value;
+		}
+		else if (value && strcmp(arg, "--checkpoint-interval") == 0)
+		{
+			checkpointSeconds = atof(value);
+		}
+		else if (value && strcmp(arg, "--resume") == 0)
+		{
+			resumeFileName = value;
+		}
+		else if (value && strcmp(arg, "--threads") == 0)
+		{
+			threadCount = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--bench") == 0)
+		{
+			bench.runCount = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--warmup") == 0)
+		{
+			bench.warmupCount = (u32)atoi(value);
+		}
+		else if (value && strcmp(arg, "--json") == 0)
+		{
+			bench.jsonFileName = value;
+		}
+		else if (value && strcmp(arg, "--suite") == 0)
+		{
+			suiteFileName = value;
+		}
+		else if (value && strcmp(arg, "--baseline") == 0)
+		{
+			baselineFileName = value;
+		}
+		else if (value && strcmp(arg, "--tolerance") == 0)
+		{
+			tolerance = atof(value);
+		}
+		else if (value && strcmp(arg, "--write-cache") == 0)
+		{
+			cacheFileName = value;
+		}
+		else if (strcmp(arg, "--wavefront") == 0)
+		{
+			// NOTE: a flag, takes no value
+			wavefront = true;
+			continue;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--scene file] [--width n] [--height n] [--spp n] [--bounces n] [--output file.bmp]\n"
+				"       [--adaptive threshold] [--min-spp n] [--spp-heatmap file.bmp] [--sampler random|sobol]\n"
+				"       [--roulette n] [--progressive spp] [--time-budget seconds]\n"
+				"       [--checkpoint file] [--checkpoint-interval seconds] [--resume file]\n"
+				"       [--lanes 1|4|8|16] [--wavefront] [--threads n] [--write-cache file.rayc]\n"
+				"       [--bench runs] [--warmup runs] [--json file]\n"
+				"       [--suite results.json] [--baseline results.json] [--tolerance percent]\n", argv[0]);
+			return 1;
+		}
+		++argIndex;
+	}
+	LaneKernel* kernel = PickLaneKernel(requestedLaneWidth);
 
 	u32 coreCount = 1;
 #if USE_MULTI_THREADING
 	coreCount = GetCpuCoreCount();
 #endif
-	u32 tileW = image.width / coreCount;
-	u32 tileH = tileW;
-	tileH = tileW = 64;
-	u32 tileCountX = (image.width + tileW - 1) / tileW;
-	u32 tileCountY = (image.height + tileH - 1) / tileH;
-	u32 tileTotal = tileCountX * tileCountY;
-
-	WorkQueue queue = {};
-	queue.workOrders = (WorkOrder *)malloc(tileTotal * sizeof(WorkOrder));
-	queue.raysPerPixel = RAYS_PER_PIXEL;
-	queue.maxBounceCount = 8;
-
-	printf("Config: %d cores with %d of %dx%d tiles, with %d-wide lanes\n", coreCount, tileTotal, tileW, tileH, LANE_WIDTH);
-	printf("Quality: %d rays per pixel, max %d bounces\n", queue.raysPerPixel, queue.maxBounceCount);
+	if (threadCount)
+	{
+		coreCount = threadCount;
+	}
 
-	for (u32 tileY = 0; tileY < tileCountY; ++tileY)
+	if (suiteFileName)
 	{
-		u32 minY = tileY * tileH;
-		u32 maxY = minY + tileH;
-		if (maxY > image.height)
+		if (bench.runCount == 0)
 		{
-			maxY = image.height;
+			bench.runCount = 3;
 		}
+		return RunBenchmarkSuite(kernel, coreCount, wavefront, &bench, suiteFileName, baselineFileName, tolerance);
+	}
+	if (bench.jsonFileName && bench.runCount == 0)
+	{
+		bench.runCount = 5;
+	}
 
-		for (u32 tileX = 0; tileX < tileCountX; ++tileX)
-		{
-			u32 minX = tileX * tileW;
-			u32 maxX = minX + tileW;
-			if (maxX > image.width)
-			{
-				maxX = image.width;
-			}
-
-			WorkOrder* order = &queue.workOrders[queue.workOrderCount++];
-			assert(queue.workOrderCount <= tileTotal);
+	Scene scene;
+	InitScene(&scene);
+	// NOTE: a cached scene comes with its BVHs and packed arrays already built
+	bool cached = sceneFileName && IsSceneCacheFile(sceneFileName);
+	bool loaded = false;
+	if (cached)
+	{
+		loaded = LoadSceneCache(&scene, sceneFileName);
+	}
+	else
+	{
+		loaded = sceneFileName ? LoadScene(&scene, sceneFileName) : LoadDefaultScene(&scene);
+	}
+	if (!loaded)
+	{
+		return 1;
+	}
 
-			order->world = &world;
-			order->image = image;
-			order->minX = minX;
-			order->maxX = maxX;
-			order->minY = minY;
-			order->maxY = maxY;
+	if (width)
+	{
+		scene.imageWidth = width;
+	}
+	if (height)
+	{
+		scene.imageHeight = height;
+	}
+	if (raysPerPixel)
+	{
+		scene.raysPerPixel = raysPerPixel;
+	}
+	if (maxBounceCount >= 0)
+	{
+		scene.maxBounceCount = (u32)maxBounceCount;
+	}
+	if (rouletteStartBounce >= 0)
+	{
+		scene.rouletteStartBounce = (u32)rouletteStartBounce;
+	}
+	if (adaptiveThreshold >= 0.0f)
+	{
+		scene.adaptiveThreshold = adaptiveThreshold;
+	}
+	if (minRaysPerPixel)
+	{
+		scene.minRaysPerPixel = minRaysPerPixel;
+	}
+	if (samplerKind >= 0)
+	{
+		scene.samplerKind = (u32)samplerKind;
+	}
+	if (outputFileName)
+	{
+		free(scene.outputFileName);
+		scene.outputFileName = CopyString(outputFileName);
+	}
 
-			// NOTE: temporary entropy
-			RandomSeries entropy = {LaneU32FromU32(29807612 + tileX * 12301 + tileY * 127659,
-												56094376 + tileX * 31085 + tileY * 805672,
-												10957868 + tileX * 29067 + tileY * 310784,
-												67820193 + tileX * 17453 + tileY * 209485) };
-			order->entropy = entropy;
+	World* world = &scene.world;
+	if (!cached)
+	{
+		PrepareWorld(world, kernel->laneWidth);
+	}
+	else if (world->sphereBVH.leafWidth != GetSphereLeafWidth(kernel->laneWidth))
+	{
+		// NOTE: any leaves render right, only the speed suffers
+		fprintf(stderr, "[WARNING] Scene cache %s has sphere leaves sized for other lanes, rewrite it with --lanes %d for full speed.\n",
+			sceneFileName, kernel->laneWidth);
+	}
+	if (cacheFileName)
+	{
+		bool written = WriteSceneCache(&scene, cacheFileName);
+		if (written)
+		{
+			printf("Wrote scene cache %s\n", cacheFileName);
 		}
+		return written ? 0 : 1;
 	}
-	assert(queue.workOrderCount == tileTotal);
 
-	// NOTE: For fencing
-	LockedAdd(&queue.NextWorkOrderIndex, 0);
+	RoundRaysPerPixel(&scene, kernel);
+	// NOTE: a budgeted render goes one lane of rays per pixel at a time unless told otherwise,
+	// so even a slow scene gets a complete first pass early and latency stays close to the budget
+	bool snapshots = (passRaysPerPixel != 0);
+	if (!passRaysPerPixel && (checkpointFileName || resumeFileName))
+	{
+		passRaysPerPixel = CHECKPOINT_PASS_RAYS_PER_PIXEL;
+	}
+	else if (!passRaysPerPixel && budgetSeconds > 0.0)
+	{
+		passRaysPerPixel = kernel->laneWidth;
+	}
+	if (passRaysPerPixel)
+	{
+		// NOTE: every pass casts whole lanes too
+		u32 laneWidth = kernel->laneWidth;
+		passRaysPerPixel = (passRaysPerPixel + laneWidth - 1) / laneWidth * laneWidth;
+	}
+	if (scene.imageWidth == 0 || scene.imageHeight == 0)
+	{
+		fprintf(stderr, "[ERROR] Image size must not be zero.\n");
+		return 1;
+	}
+
+	ImageU32 image = CreateImage(scene.imageWidth, scene.imageHeight);
 
-	clock_t startClock = clock();
+	WorkQueue queue;
+	InitRenderQueue(&queue, &scene, image, kernel, coreCount, wavefront);
 
-	for (u32 coreIndex = 1; coreIndex < coreCount; ++coreIndex)
+	printf("Config: %d cores with %d of %dx%d tiles, with %d-wide %s lanes\n", coreCount, GetTileCount(image), TILE_SIZE, TILE_SIZE, kernel->laneWidth, kernel->name);
+	if (wavefront)
+	{
+		printf("Wavefront: blocks of %dx%d pixels cast as waves of rays, compacted and sorted by surface every bounce\n",
+			TILE_BLOCK_SIZE, TILE_BLOCK_SIZE);
+	}
+	printf("Quality: %d rays per pixel, max %d bounces\n", queue.raysPerPixel, queue.maxBounceCount);
+	if (queue.rouletteStartBounce < queue.maxBounceCount)
 	{
-		CreateThread(&queue);
+		printf("Roulette: paths may end after %d bounces\n", queue.rouletteStartBounce);
+	}
+	if (queue.adaptiveThreshold > 0.0f)
+	{
+		printf("Adaptive: error threshold %g, at least %d rays per pixel\n", queue.adaptiveThreshold, queue.minRaysPerPixel);
+	}
+	if (world->lightCount > 0)
+	{
+		printf("Lights: %d emissive spheres sampled directly\n", world->lightCount);
+	}
+	if (snapshots)
+	{
+		printf("Progressive: passes of %d rays per pixel, snapshots to %s\n", passRaysPerPixel, scene.outputFileName);
+	}
+	if (budgetSeconds > 0.0)
+	{
+		printf("Budget: %.3f s, passes of %d rays per pixel\n", budgetSeconds, passRaysPerPixel);
 	}
 
-	while (queue.tileCount < tileTotal)
+	if (bench.runCount)
 	{
-		if (RenderTile(&queue))
+		BenchmarkResult result = {};
+		result.sceneName = sceneFileName ? sceneFileName : "default";
+		result.kernelName = kernel->name;
+		result.laneWidth = kernel->laneWidth;
+		RunBenchmark(&queue, &bench, &result);
+		PrintBenchmarkResult(&result);
+		if (bench.jsonFileName && !WriteBenchmarkJSONFile(&result, bench.jsonFileName))
 		{
-			printf("\rRaycasting %d%%...   ", 100 * (u32)queue.tileCount / tileTotal);
-			fflush(stdout);
+			return 1;
 		}
 	}
+	else
+	{
+		f64 startSeconds = GetWallClockSeconds();
+		if (passRaysPerPixel)
+		{
+			ProgressiveSettings progressive = {};
+			progressive.passRaysPerPixel = passRaysPerPixel;
+			progressive.budgetSeconds = budgetSeconds;
+			progressive.snapshotFileName = snapshots ? scene.outputFileName : 0;
+			progressive.checkpointFileName = checkpointFileName;
+			progressive.resumeFileName = resumeFileName;
+			progressive.checkpointSeconds = checkpointSeconds;
+			progressive.laneWidth = kernel->laneWidth;
+			if (!RenderProgressive(&queue, &progressive))
+			{
+				return 1;
+			}
+		}
+		else
+		{
+			RenderFrame(&queue, PrintProgress, 0);
+		}
+		f64 seconds = GetWallClockSeconds() - startSeconds;
 
-	clock_t endClock = clock();
-	clock_t elapsed = endClock - startClock;
-	printf("\nRaycasting Time: %d ms\n", elapsed);
-	printf("Total bounces: %llu\n", queue.totalBounces);
-	printf("Performance %f ms/bounce\n", elapsed / (f64)queue.totalBounces);
+		printf("\nRaycasting Time: %.3f s\n", seconds);
+		printf("Total rays: %llu (%.1f per pixel), bounces: %llu\n", (unsigned long long)queue.totalRays,
+			(f64)queue.totalRays / queue.pixelTotal, (unsigned long long)queue.totalBounces);
+		printf("Performance: %.2f Mrays/s, %.2f Mbounces/s\n", 1e-6 * queue.totalRays / seconds, 1e-6 * queue.totalBounces / seconds);
+		if (queue.totalLaneSlots)
+		{
+			printf("Lane use: %.1f%% of the lanes intersected carried a live ray\n", 100.0 * queue.totalBounces / queue.totalLaneSlots);
+		}
+	}
 
-	WriteImage(image, "result.bmp");
+	WriteImage(image, scene.outputFileName);
+	if (heatmapFileName)
+	{
+		ImageU32 heatmap = MakeSampleHeatmap(queue.sampleCounts, image.width, image.height, queue.raysPerPixel);
+		WriteImage(heatmap, heatmapFileName);
+	}
 	printf("Done!\n");
 	return 0;
 }
\ No newline at end of file
@@ -3,6 +3,28 @@
 
 #define ARRAY_COUNT(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+// NOTE: widest lane any kernel is built for, sizes per-lane state shared with the host
+#define MAX_LANE_WIDTH 16
+
+// NOTE: temporary epsilons shared by every intersection routine
+#define MIN_HIT_DIST 0.001f
+#define HIT_EPSILON 0.0001f
+// NOTE: shadow rays stop this fraction short of the light, so they don't find the light itself
+#define LIGHT_DIST_EPSILON 0.001f
+
+// NOTE: keeps adaptive sampling from chasing relative error in nearly black pixels
+#define ADAPTIVE_ERROR_FLOOR 0.01f
+
+// NOTE: a path that passes Russian roulette never survives with more than this
+#define ROULETTE_MAX_SURVIVAL 0.95f
+
+// NOTE: Material::lightIndex of every material that isn't a light's own
+#define LIGHT_NONE 0xFFFFFFFF
+
+// NOTE: where the kernel's sample dimensions come from, see ray_sampler.h
+#define SAMPLER_RANDOM 0
+#define SAMPLER_SOBOL 1
+
 #pragma pack(push, 1)
 struct BitmapHeader
 {
@@ -32,11 +54,18 @@ struct ImageU32
 	u32* pixels;
 };
 
+struct MappedFile
+{
+	size_t size;
+	void* contents;
+};
+
 struct Material
 {
 	vec3 emitColor;
 	vec3 reflectColor;
-	f32 specular; // 0 - pure diffuse, 1 - mirror
+	f32 specular; // 0 - pure diffuse, 1 - mirror, glossy with roughness 1 - specular between
+	u32 lightIndex; // NOTE: LIGHT_NONE unless this is a light's own copy, see BuildLightList
 };
 
 struct Plane
@@ -53,6 +82,87 @@ struct Sphere
 	u32 matIndex;
 };
 
+// NOTE: an emissive sphere the kernel samples directly, picked in proportion to its power
+struct Light
+{
+	vec3 pos;
+	f32 radius;
+	vec3 emitColor;
+	f32 pickProbability;
+	f32 pickCDF; // NOTE: probability of picking one of the lights before this one
+};
+
+// NOTE: indexes World::vertices, meshes share one vertex buffer
+struct Triangle
+{
+	u32 vertexIndex[3];
+	u32 matIndex;
+};
+
+struct AABB
+{
+	vec3 min;
+	vec3 max;
+};
+
+// NOTE: primCount == 0 marks an interior node, its children are firstIndex and firstIndex + 1
+struct BVHNode
+{
+	AABB bounds;
+	u32 firstIndex;
+	u16 primCount;
+	u16 splitAxis;
+};
+
+struct BVH
+{
+	u32 nodeCount;
+	BVHNode* nodes;
+	u32 depth; // NOTE: of the deepest node, the root is 0
+	u32 leafWidth; // NOTE: primitives per wide leaf test the leaves were sized for, see BuildBVH
+};
+
+// NOTE: a traversal holds at most one sibling per level above the node it's on and its two children,
+// the builder keeps every tree within BVH_MAX_DEPTH so that always fits
+#define BVH_STACK_SIZE 64
+#define BVH_MAX_DEPTH (BVH_STACK_SIZE - 1)
+
+#define PRIMITIVE_SPHERE 0
+#define PRIMITIVE_TRIANGLE 1
+
+// NOTE: packed copies of the primitive arrays for streaming lane loads, padded past
+// the end so a LANE_WIDTH load starting at any primitive stays in bounds
+struct SphereSoA
+{
+	f32* x;
+	f32* y;
+	f32* z;
+	f32* radius;
+	u32* matIndex;
+};
+
+struct PlaneSoA
+{
+	f32* nx;
+	f32* ny;
+	f32* nz;
+	f32* dist;
+	u32* matIndex;
+};
+
+// NOTE: Material split into one array per component, so a lane batch's lookups are plain 4 byte gathers
+struct MaterialSoA
+{
+	f32* emitR;
+	f32* emitG;
+	f32* emitB;
+	f32* reflectR;
+	f32* reflectG;
+	f32* reflectB;
+	f32* specular;
+	u32* lightIndex;
+};
+
 struct World
 {
 	u32 materialCount;
@@ -63,44 +173,229 @@ struct World
 
 	u32 sphereCount;
 	Sphere* spheres;
+
+	u32 vertexCount;
+	vec3* vertices;
+
+	u32 triangleCount;
+	Triangle* triangles;
+
+	u32 lightCount;
+	Light* lights;
+
+	// NOTE: planes are unbounded and stay a flat list
+	BVH sphereBVH;
+	BVH triangleBVH;
+
+	SphereSoA sphereSoA;
+	PlaneSoA planeSoA;
+	MaterialSoA materialSoA;
 };
 
-struct RandomSeries
+struct Camera
 {
-	lane_u32 state;
+	vec3 pos;
+	vec3 x;
+	vec3 y;
+	vec3 z;
+
+	vec3 filmCenter;
+	f32 filmW;
+	f32 filmH;
 };
 
+// NOTE: everything a scene file describes, see ray_scene.h for the format
+struct Scene
+{
+	World world;
+
+	vec3 cameraPos;
+	vec3 cameraTarget;
+
+	u32 imageWidth;
+	u32 imageHeight;
+	u32 raysPerPixel;
+	u32 maxBounceCount;
+	u32 rouletteStartBounce; // NOTE: maxBounceCount or more turns Russian roulette off
+	f32 adaptiveThreshold; // NOTE: 0 always casts raysPerPixel
+	u32 minRaysPerPixel;
+	u32 samplerKind;
+	char* outputFileName;
+};
+
+// NOTE: a rectangle of whole tile blocks, clipped to the image
 struct WorkOrder
 {
-	World* world;
-	ImageU32 image;
 	u32 minX;
 	u32 maxX;
 	u32 minY;
 	u32 maxY;
-	RandomSeries entropy;
+};
+
+// NOTE: the owner pushes and pops at the bottom, thieves take from the top
+struct TileDeque
+{
+	volatile u32 lock;
+	u32 top;
+	u32 bottom;
+	u32 capacity;
+	WorkOrder* orders;
+};
+
+// NOTE: written only by the owning thread, padded so neighbours don't share a cache line
+struct WorkThreadStats
+{
+	u64 tileCount;
+	f64 busySeconds;
+	u8 padding[48];
+};
+
+struct CastState;
+typedef void CastSampleRaysFn(CastState* cast);
+typedef void CastBlockRaysFn(CastState* cast);
+
+// NOTE: rays of a wavefront cast in structure of arrays, one entry per ray, see ray_wavefront.h
+struct RayStreamSoA
+{
+	f32* originX;
+	f32* originY;
+	f32* originZ;
+	f32* dirX;
+	f32* dirY;
+	f32* dirZ;
+	f32* attenuationX;
+	f32* attenuationY;
+	f32* attenuationZ;
+	f32* sampleX;
+	f32* sampleY;
+	f32* sampleZ;
+	f32* scatterPdf;
+	u32* scatterMisMask;
+
+	// NOTE: the sampler state that differs between paths, the dimension is the same for all of them
+	u32* pixelSeed;
+	u32* reversedSampleIndex;
+	u32* randomState;
+
+	u32* pathIndex; // NOTE: where the ray's path started in the wave, its color goes there when it ends
+
+	f32* hitDist;
+	u32* hitMaterial;
+	f32* normalX;
+	f32* normalY;
+	f32* normalZ;
+};
+
+// NOTE: a thread's scratch for the wavefront kernel. Rays go back and forth between the two buffers,
+// sorted by surface into two regions of regionSize entries each, capacity rays and a lane of padding
+struct RayStream
+{
+	u32 capacity;
+	u32 regionSize;
+	RayStreamSoA rays;
+	RayStreamSoA sorted;
+
+	// NOTE: per path of the wave
+	vec3* pathColor;
+	u32* pathPixel;
+
+	// NOTE: per pixel of the block, row by row. In: rays cast and luminance sums of earlier passes, and
+	// whether adaptive sampling stopped the pixel. Out: mean color and rays cast, the sums and flag updated
+	u32* activePixels;
+	u32* priorRayCount;
+	f32* luminanceSum;
+	f32* luminanceSqSum;
+	u8* converged;
+	vec3* pixelColor;
+	u32* pixelRayCount;
+};
+
+// NOTE: the part of a BVH a block's frustum reaches, front to back along the block's center ray. A node
+// with primCount > 0 is a leaf cut down to what's inside the frustum, firstIndex points into the packet's
+// own copies of the primitives. One with primCount == 0 stands for the whole subtree below BVH node
+// firstIndex, where the packet ran out of room
+struct PacketNodes
+{
+	u32 nodeCount;
+	BVHNode* nodes;
+};
+
+// NOTE: what the camera rays of one block can hit, see ray_packet.h
+struct RayPacket
+{
+	u32 planeCount;
+	PlaneSoA planes;
+
+	PacketNodes sphereNodes;
+	SphereSoA spheres;
+
+	PacketNodes triangleNodes;
+	Triangle* triangles;
 };
 
 struct WorkQueue
 {
-	u32 workOrderCount;
-	WorkOrder* workOrders;
-	volatile u64 NextWorkOrderIndex;
+	World* world;
+	ImageU32 image;
+
+	u32 threadCount;
+	TileDeque* deques;
+	WorkThreadStats* threadStats;
+	volatile u64 pendingOrderCount; // NOTE: orders sitting in deques or moving between them
+	volatile u64 totalRays;
 	volatile u64 totalBounces;
-	volatile u64 tileCount;
+	volatile u64 totalLaneSlots; // NOTE: lanes intersected, bounces over this is the lane use
+	volatile u64 pixelCount;
+	u64 pixelTotal;
+	volatile u32 frameDone; // NOTE: set and woken by whoever finishes the last tile or sees the deadline
+	f64 deadline; // NOTE: wall clock seconds after which no new block is started, 0 renders the whole frame
 
 	u32 raysPerPixel;
+	u32 passRaysPerPixel; // NOTE: rays per pixel a single RenderFrame adds, raysPerPixel unless progressive
+	u32 firstSampleIndex; // NOTE: where the pass picks up, every pass draws new samples
 	u32 maxBounceCount;
+	u32 rouletteStartBounce;
+	f32 adaptiveThreshold;
+	u32 minRaysPerPixel;
+	u32 samplerKind;
+	Camera camera;
+	CastSampleRaysFn* castSampleRays;
+	CastBlockRaysFn* castBlockRays; // NOTE: set in wavefront mode, which casts a block at a time
+	RayStream* streams; // NOTE: one per thread in wavefront mode
+	RayPacket* packets; // NOTE: one per thread, rebuilt for every block
+
+	// NOTE: linear color and rays cast summed over every pass since the last ClearAccumulation,
+	// the image is resolved from them as each pixel finishes
+	vec3* accumulation;
+	u32* sampleCounts;
+	// NOTE: adaptive sampling's luminance sums over the same passes, so the stopping rule sees every ray
+	// of a pixel, and the pixels it stopped, which later passes skip
+	f32* luminanceSums;
+	f32* luminanceSqSums;
+	u8* converged;
+};
+
+struct WorkThread
+{
+	WorkQueue* queue;
+	u32 threadIndex;
 };
 
+typedef void RenderProgressFn(u64 pixelCount, u64 pixelTotal, void* data);
+
 
 struct CastState
 {
 	// In
 	World* world;
-	u32 raysPerPixel;
+	u32 raysPerPixel; // NOTE: the cap when sampling adaptively
 	u32 maxBounceCount;
-	RandomSeries* entropy;
+	u32 rouletteStartBounce;
+	f32 adaptiveThreshold;
+	u32 minRaysPerPixel;
+	u32 samplerKind;
+	u32 pixelIndex;
+	u32 firstSampleIndex; // NOTE: samples firstSampleIndex up to the cap are drawn, see random_gen.h
 
 	vec3 cameraX;
 	vec3 cameraY;
@@ -116,9 +411,41 @@ struct CastState
 	f32 filmX;
 	f32 filmY;
 
+	// NOTE: what a wavefront cast covers instead of a single pixel
+	u32 imageWidth;
+	u32 imageHeight;
+	u32 blockMinX;
+	u32 blockMaxX;
+	u32 blockMinY;
+	u32 blockMaxY;
+	RayStream* stream;
+
+	RayPacket* packet; // NOTE: what the camera rays of the block can hit, 0 to search the whole world
+
+	u32 priorRayCount; // NOTE: rays the pixel got in earlier passes, adaptive sampling goes on from there
+
+	// In and out: the pixel's luminance sums, over earlier passes in and including this one out
+	f32 luminanceSum;
+	f32 luminanceSqSum;
+
 	// Out
 	vec3 finalColor;
+	u32 raysCast;
+	bool converged; // NOTE: adaptive sampling stopped the pixel, later passes skip it
 	u64 bouncesComputed;
+	u64 laneSlotsComputed;
 };
 
+// NOTE: one build of the sample kernel per lane backend, see ray_kernel.h
+void CastSampleRaysScalar(CastState* cast);
+void CastSampleRaysSSE2(CastState* cast);
+void CastSampleRaysAVX2(CastState* cast);
+void CastSampleRaysAVX512(CastState* cast);
+
+// NOTE: the wavefront kernel of every lane backend, casts a block of pixels, see ray_wavefront.h
+void CastBlockRaysScalar(CastState* cast);
+void CastBlockRaysSSE2(CastState* cast);
+void CastBlockRaysAVX2(CastState* cast);
+void CastBlockRaysAVX512(CastState* cast);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,273 @@
+#if !defined RAY_BENCH_H
+# define RAY_BENCH_H
+
+//
+// Benchmark harness
+//
+// Renders the same frame a few times after some warmup runs and reports wall clock statistics,
+// throughput and how busy every thread was, as text and optionally as JSON.
+//
+
+#define MAX_BENCHMARK_RUNS 256
+
+static void RenderFrame(WorkQueue* queue, RenderProgressFn* progress, void* progressData);
+static void ClearAccumulation(WorkQueue* queue);
+
+struct BenchmarkSettings
+{
+	u32 warmupCount;
+	u32 runCount;
+	const char* jsonFileName;
+};
+
+struct BenchmarkStats
+{
+	f64 median;
+	f64 mean;
+	f64 stddev;
+	f64 min;
+	f64 max;
+};
+
+struct BenchmarkResult
+{
+	const char* sceneName;
+	const char* kernelName;
+	u32 laneWidth;
+	u32 threadCount;
+	u32 samplerKind;
+	bool wavefront;
+	u32 imageWidth;
+	u32 imageHeight;
+	u32 raysPerPixel;
+	u32 maxBounceCount;
+	u32 warmupCount;
+	u32 runCount;
+
+	// NOTE: primary rays actually cast (pixels * samples unless adaptive), bounces are every ray segment traced
+	u64 raysPerRun;
+	u64 bouncesPerRun;
+	f64 runSeconds[MAX_BENCHMARK_RUNS];
+
+	BenchmarkStats seconds;
+	BenchmarkStats raysPerSecond;
+	BenchmarkStats bouncesPerSecond;
+
+	// NOTE: summed over the measured runs
+	WorkThreadStats* threadStats;
+};
+
+static int CompareF64(const void* a, const void* b)
+{
+	f64 x = *(const f64*)a;
+	f64 y = *(const f64*)b;
+	int result = (x < y) ? -1 : ((x > y) ? 1 : 0);
+
+	return result;
+}
+
+static BenchmarkStats ComputeBenchmarkStats(f64* values, u32 count)
+{
+	BenchmarkStats result = {};
+	if (count == 0)
+	{
+		return result;
+	}
+
+	f64 sorted[MAX_BENCHMARK_RUNS];
+	memcpy(sorted, values, sizeof(f64) * count);
+	qsort(sorted, count, sizeof(f64), CompareF64);
+
+	result.min = sorted[0];
+	result.max = sorted[count - 1];
+	result.median = (count & 1) ? sorted[count / 2] : 0.5 * (sorted[count / 2 - 1] + sorted[count / 2]);
+
+	f64 sum = 0.0;
+	for (u32 index = 0; index < count; ++index)
+	{
+		sum += values[index];
+	}
+	result.mean = sum / count;
+
+	// NOTE: sample standard deviation, runs are a sample of what the machine can do
+	if (count > 1)
+	{
+		f64 squares = 0.0;
+		for (u32 index = 0; index < count; ++index)
+		{
+			f64 delta = values[index] - result.mean;
+			squares += delta * delta;
+		}
+		result.stddev = sqrt(squares / (count - 1));
+	}
+
+	return result;
+}
+
+static void RunBenchmark(WorkQueue* queue, BenchmarkSettings* settings, BenchmarkResult* result)
+{
+	u32 threadCount = queue->threadCount;
+	u32 runCount = settings->runCount;
+	if (runCount > MAX_BENCHMARK_RUNS)
+	{
+		fprintf(stderr, "[WARNING] Benchmark limited to %d runs.\n", MAX_BENCHMARK_RUNS);
+		runCount = MAX_BENCHMARK_RUNS;
+	}
+
+	result->threadCount = threadCount;
+	result->samplerKind = queue->samplerKind;
+	result->wavefront = (queue->castBlockRays != 0);
+	result->imageWidth = queue->image.width;
+	result->imageHeight = queue->image.height;
+	result->raysPerPixel = queue->raysPerPixel;
+	result->maxBounceCount = queue->maxBounceCount;
+	result->warmupCount = settings->warmupCount;
+	result->runCount = runCount;
+	result->threadStats = (WorkThreadStats*)calloc(threadCount, sizeof(WorkThreadStats));
+
+	for (u32 warmupIndex = 0; warmupIndex < settings->warmupCount; ++warmupIndex)
+	{
+		ClearAccumulation(queue);
+		RenderFrame(queue, 0, 0);
+	}
+
+	f64 raysPerSecond[MAX_BENCHMARK_RUNS];
+	f64 bouncesPerSecond[MAX_BENCHMARK_RUNS];
+	for (u32 runIndex = 0; runIndex < runCount; ++runIndex)
+	{
+		ClearAccumulation(queue);
+		f64 startSeconds = GetWallClockSeconds();
+		RenderFrame(queue, 0, 0);
+		f64 seconds = GetWallClockSeconds() - startSeconds;
+
+		result->runSeconds[runIndex] = seconds;
+		// NOTE: adaptive sampling makes the ray count depend on the scene, not just the settings
+		result->raysPerRun = queue->totalRays;
+		result->bouncesPerRun = queue->totalBounces;
+		raysPerSecond[runIndex] = queue->totalRays / seconds;
+		bouncesPerSecond[runIndex] = queue->totalBounces / seconds;
+
+		for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+		{
+			result->threadStats[threadIndex].tileCount += queue->threadStats[threadIndex].tileCount;
+			result->threadStats[threadIndex].busySeconds += queue->threadStats[threadIndex].busySeconds;
+		}
+
+		printf("\rBenchmark run %d/%d: %.3f s   ", runIndex + 1, runCount, seconds);
+		fflush(stdout);
+	}
+	printf("\n");
+
+	result->seconds = ComputeBenchmarkStats(result->runSeconds, runCount);
+	result->raysPerSecond = ComputeBenchmarkStats(raysPerSecond, runCount);
+	result->bouncesPerSecond = ComputeBenchmarkStats(bouncesPerSecond, runCount);
+}
+
+static void PrintBenchmarkResult(BenchmarkResult* result)
+{
+	printf("Benchmark %s: %d runs after %d warmup, %d threads, %d-wide %s lanes\n",
+		result->sceneName, result->runCount, result->warmupCount, result->threadCount, result->laneWidth, result->kernelName);
+	printf("  time       median %.3f s  mean %.3f s  stddev %.3f s  min %.3f s  max %.3f s\n",
+		result->seconds.median, result->seconds.mean, result->seconds.stddev, result->seconds.min, result->seconds.max);
+	printf("  rays/s     median %.2f M  stddev %.2f M\n",
+		1e-6 * result->raysPerSecond.median, 1e-6 * result->raysPerSecond.stddev);
+	printf("  bounces/s  median %.2f M  stddev %.2f M\n",
+		1e-6 * result->bouncesPerSecond.median, 1e-6 * result->bouncesPerSecond.stddev);
+
+	f64 totalSeconds = result->seconds.mean * result->runCount;
+	for (u32 threadIndex = 0; threadIndex < result->threadCount; ++threadIndex)
+	{
+		WorkThreadStats* stats = &result->threadStats[threadIndex];
+		printf("  thread %-3d tiles %.1f  busy %.3f s (%.0f%%)\n", threadIndex,
+			(f64)stats->tileCount / result->runCount, stats->busySeconds / result->runCount,
+			(totalSeconds > 0.0) ? 100.0 * stats->busySeconds / totalSeconds : 0.0);
+	}
+}
+
+static void WriteJSONString(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (const char* at = text; *at; ++at)
+	{
+		if (*at == '"' || *at == '\\')
+		{
+			fputc('\\', file);
+			fputc(*at, file);
+		}
+		else if ((u8)*at < 0x20)
+		{
+			fprintf(file, "\\u%04x", (u8)*at);
+		}
+		else
+		{
+			fputc(*at, file);
+		}
+	}
+	fputc('"', file);
+}
+
+static void WriteBenchmarkStatsJSON(FILE* file, const char* name, BenchmarkStats* stats)
+{
+	fprintf(file, "  \"%s\": { \"median\": %.9g, \"mean\": %.9g, \"stddev\": %.9g, \"min\": %.9g, \"max\": %.9g },\n",
+		name, stats->median, stats->mean, stats->stddev, stats->min, stats->max);
+}
+
+static void WriteBenchmarkJSON(FILE* file, BenchmarkResult* result)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "  \"scene\": ");
+	WriteJSONString(file, result->sceneName);
+	fprintf(file, ",\n  \"kernel\": ");
+	WriteJSONString(file, result->kernelName);
+	fprintf(file, ",\n");
+	fprintf(file, "  \"laneWidth\": %u,\n", result->laneWidth);
+	fprintf(file, "  \"threads\": %u,\n", result->threadCount);
+	fprintf(file, "  \"sampler\": \"%s\",\n", GetSamplerName(result->samplerKind));
+	fprintf(file, "  \"wavefront\": %s,\n", result->wavefront ? "true" : "false");
+	fprintf(file, "  \"width\": %u,\n", result->imageWidth);
+	fprintf(file, "  \"height\": %u,\n", result->imageHeight);
+	fprintf(file, "  \"raysPerPixel\": %u,\n", result->raysPerPixel);
+	fprintf(file, "  \"maxBounceCount\": %u,\n", result->maxBounceCount);
+	fprintf(file, "  \"warmup\": %u,\n", result->warmupCount);
+	fprintf(file, "  \"runs\": %u,\n", result->runCount);
+	fprintf(file, "  \"raysPerRun\": %llu,\n", (unsigned long long)result->raysPerRun);
+	fprintf(file, "  \"bouncesPerRun\": %llu,\n", (unsigned long long)result->bouncesPerRun);
+	WriteBenchmarkStatsJSON(file, "seconds", &result->seconds);
+	WriteBenchmarkStatsJSON(file, "raysPerSecond", &result->raysPerSecond);
+	WriteBenchmarkStatsJSON(file, "bouncesPerSecond", &result->bouncesPerSecond);
+
+	fprintf(file, "  \"runSeconds\": [");
+	for (u32 runIndex = 0; runIndex < result->runCount; ++runIndex)
+	{
+		fprintf(file, "%s%.9g", runIndex ? ", " : " ", result->runSeconds[runIndex]);
+	}
+	fprintf(file, " ],\n");
+
+	fprintf(file, "  \"threadStats\": [\n");
+	for (u32 threadIndex = 0; threadIndex < result->threadCount; ++threadIndex)
+	{
+		WorkThreadStats* stats = &result->threadStats[threadIndex];
+		fprintf(file, "    { \"tiles\": %.9g, \"busySeconds\": %.9g }%s\n",
+			(f64)stats->tileCount / result->runCount, stats->busySeconds / result->runCount,
+			(threadIndex + 1 < result->threadCount) ? "," : "");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+}
+
+static bool WriteBenchmarkJSONFile(BenchmarkResult* result, const char* fileName)
+{
+	FILE* file = fopen(fileName, "w");
+	if (!file)
+	{
+		fprintf(stderr, "[ERROR] Unable to write benchmark results %s.\n", fileName);
+		return false;
+	}
+
+	WriteBenchmarkJSON(file, result);
+	fclose(file);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,438 @@
+#if !defined RAY_BVH_H
+# define RAY_BVH_H
+
+//
+// Bounding volume hierarchy
+//
+
+#define BVH_BIN_COUNT 16
+#define BVH_MAX_LEAF_SIZE 4
+// NOTE: SAH cost of one node visit relative to one primitive test, or one wide test of leafWidth primitives
+#define BVH_TRAVERSAL_COST 1.0f
+
+static AABB EmptyAABB()
+{
+	AABB result;
+	result.min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	result.max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	return result;
+}
+
+static AABB Union(AABB a, AABB b)
+{
+	AABB result;
+	result.min = { MinF32(a.min.x, b.min.x), MinF32(a.min.y, b.min.y), MinF32(a.min.z, b.min.z) };
+	result.max = { MaxF32(a.max.x, b.max.x), MaxF32(a.max.y, b.max.y), MaxF32(a.max.z, b.max.z) };
+
+	return result;
+}
+
+static AABB Union(AABB a, vec3 p)
+{
+	AABB result;
+	result.min = { MinF32(a.min.x, p.x), MinF32(a.min.y, p.y), MinF32(a.min.z, p.z) };
+	result.max = { MaxF32(a.max.x, p.x), MaxF32(a.max.y, p.y), MaxF32(a.max.z, p.z) };
+
+	return result;
+}
+
+static f32 SurfaceArea(AABB box)
+{
+	f32 result = 0.0f;
+	f32 dx = box.max.x - box.min.x;
+	f32 dy = box.max.y - box.min.y;
+	f32 dz = box.max.z - box.min.z;
+	if (dx >= 0.0f && dy >= 0.0f && dz >= 0.0f)
+	{
+		result = 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	return result;
+}
+
+static vec3 Centroid(AABB box)
+{
+	vec3 result =
+	{
+		0.5f * (box.min.x + box.max.x),
+		0.5f * (box.min.y + box.max.y),
+		0.5f * (box.min.z + box.max.z)
+	};
+	return result;
+}
+
+struct BVHBuilder
+{
+	BVH* bvh;
+	AABB* primBounds;
+	u32* primIndices;
+	u32 leafWidth; // NOTE: primitives a leaf test covers at once, 1 for one at a time
+	u32 maxLeafSize;
+};
+
+static u32 CeilLog2(u32 value)
+{
+	u32 result = 0;
+	while (result < 32 && (1u << result) < value)
+	{
+		++result;
+	}
+
+	return result;
+}
+
+// NOTE: quickselect on the centroids along axis, afterwards indices[first, mid) are the ones below mid's
+static void PartitionAtMedian(BVHBuilder* builder, u32 axis, u32 first, u32 count, u32 mid)
+{
+	u32* indices = builder->primIndices;
+	u32 lo = first;
+	u32 hi = first + count - 1;
+	while (lo < hi)
+	{
+		f32 pivot = AxisValue(Centroid(builder->primBounds[indices[(lo + hi) / 2]]), axis);
+		u32 i = lo;
+		u32 j = hi;
+		while (i <= j)
+		{
+			while (AxisValue(Centroid(builder->primBounds[indices[i]]), axis) < pivot)
+			{
+				++i;
+			}
+			while (AxisValue(Centroid(builder->primBounds[indices[j]]), axis) > pivot)
+			{
+				--j;
+			}
+			if (i <= j)
+			{
+				u32 temp = indices[i];
+				indices[i] = indices[j];
+				indices[j] = temp;
+				++i;
+				if (j == 0)
+				{
+					break;
+				}
+				--j;
+			}
+		}
+
+		if (mid <= j)
+		{
+			hi = j;
+		}
+		else if (mid >= i)
+		{
+			lo = i;
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+struct BVHBin
+{
+	AABB bounds;
+	u32 count;
+};
+
+static void MakeBVHLeaf(BVHNode* node, u32 first, u32 count)
+{
+	node->firstIndex = first;
+	node->primCount = (u16)count;
+	node->splitAxis = 0;
+}
+
+static void SubdivideBVHNode(BVHBuilder* builder, u32 nodeIndex, u32 first, u32 count, u32 depth)
+{
+	BVH* bvh = builder->bvh;
+	u32* indices = builder->primIndices;
+
+	AABB bounds = EmptyAABB();
+	AABB centroidBounds = EmptyAABB();
+	for (u32 i = first; i < first + count; ++i)
+	{
+		AABB primBounds = builder->primBounds[indices[i]];
+		bounds = Union(bounds, primBounds);
+		centroidBounds = Union(centroidBounds, Centroid(primBounds));
+	}
+	bvh->nodes[nodeIndex].bounds = bounds;
+	if (depth > bvh->depth)
+	{
+		bvh->depth = depth;
+	}
+
+	if (count <= 1)
+	{
+		MakeBVHLeaf(&bvh->nodes[nodeIndex], first, count);
+		return;
+	}
+
+	// NOTE: SAH can peel a single primitive off at every level, on sizes or positions that grow
+	// exponentially for instance. Once halving what's left by count would only just end at
+	// BVH_MAX_DEPTH, it does that instead, so no tree outgrows the traversal stacks
+	if (depth + CeilLog2(count) >= BVH_MAX_DEPTH)
+	{
+		u32 mid = first;
+		u32 medianAxis = 0;
+		if (count > builder->maxLeafSize)
+		{
+			vec3 extent = centroidBounds.max - centroidBounds.min;
+			if (extent.y > AxisValue(extent, medianAxis))
+			{
+				medianAxis = 1;
+			}
+			if (extent.z > AxisValue(extent, medianAxis))
+			{
+				medianAxis = 2;
+			}
+
+			mid = first + count / 2;
+			PartitionAtMedian(builder, medianAxis, first, count, mid);
+		}
+
+		if (mid == first)
+		{
+			MakeBVHLeaf(&bvh->nodes[nodeIndex], first, count);
+		}
+		else
+		{
+			u32 leftIndex = bvh->nodeCount;
+			bvh->nodeCount += 2;
+
+			BVHNode* node = &bvh->nodes[nodeIndex];
+			node->firstIndex = leftIndex;
+			node->primCount = 0;
+			node->splitAxis = (u16)medianAxis;
+
+			SubdivideBVHNode(builder, leftIndex, first, mid - first, depth + 1);
+			SubdivideBVHNode(builder, leftIndex + 1, mid, first + count - mid, depth + 1);
+		}
+		return;
+	}
+
+	// NOTE: binned SAH, every bin boundary on every axis is a split candidate
+	f32 bestCost = FLT_MAX;
+	u32 bestAxis = 0;
+	u32 bestSplit = 0;
+	for (u32 axis = 0; axis < 3; ++axis)
+	{
+		f32 axisMin = AxisValue(centroidBounds.min, axis);
+		f32 axisExtent = AxisValue(centroidBounds.max, axis) - axisMin;
+		if (axisExtent <= 0.0f)
+		{
+			continue;
+		}
+
+		BVHBin bins[BVH_BIN_COUNT];
+		for (u32 binIndex = 0; binIndex < BVH_BIN_COUNT; ++binIndex)
+		{
+			bins[binIndex].bounds = EmptyAABB();
+			bins[binIndex].count = 0;
+		}
+
+		f32 binScale = (f32)BVH_BIN_COUNT / axisExtent;
+		for (u32 i = first; i < first + count; ++i)
+		{
+			AABB primBounds = builder->primBounds[indices[i]];
+			u32 binIndex = (u32)((AxisValue(Centroid(primBounds), axis) - axisMin) * binScale);
+			if (binIndex >= BVH_BIN_COUNT)
+			{
+				binIndex = BVH_BIN_COUNT - 1;
+			}
+			bins[binIndex].bounds = Union(bins[binIndex].bounds, primBounds);
+			++bins[binIndex].count;
+		}
+
+		f32 leftArea[BVH_BIN_COUNT - 1];
+		u32 leftCount[BVH_BIN_COUNT - 1];
+		AABB leftBounds = EmptyAABB();
+		u32 leftSum = 0;
+		for (u32 split = 0; split < BVH_BIN_COUNT - 1; ++split)
+		{
+			leftBounds = Union(leftBounds, bins[split].bounds);
+			leftSum += bins[split].count;
+			leftArea[split] = SurfaceArea(leftBounds);
+			leftCount[split] = leftSum;
+		}
+
+		AABB rightBounds = EmptyAABB();
+		u32 rightSum = 0;
+		for (u32 split = BVH_BIN_COUNT - 1; split > 0; --split)
+		{
+			rightBounds = Union(rightBounds, bins[split].bounds);
+			rightSum += bins[split].count;
+			f32 cost = leftArea[split - 1] * leftCount[split - 1] + SurfaceArea(rightBounds) * rightSum;
+			if (leftCount[split - 1] > 0 && rightSum > 0 && cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	f32 parentArea = SurfaceArea(bounds);
+	f32 leafCost = (f32)((count + builder->leafWidth - 1) / builder->leafWidth);
+	f32 splitCost = BVH_TRAVERSAL_COST + SafeRatio0(bestCost, parentArea);
+
+	u32 mid = first;
+	if (bestCost < FLT_MAX && (splitCost < leafCost || count > builder->maxLeafSize))
+	{
+		f32 axisMin = AxisValue(centroidBounds.min, bestAxis);
+		f32 binScale = (f32)BVH_BIN_COUNT / (AxisValue(centroidBounds.max, bestAxis) - axisMin);
+
+		u32 lo = first;
+		u32 hi = first + count;
+		while (lo < hi)
+		{
+			u32 binIndex = (u32)((AxisValue(Centroid(builder->primBounds[indices[lo]]), bestAxis) - axisMin) * binScale);
+			if (binIndex >= BVH_BIN_COUNT)
+			{
+				binIndex = BVH_BIN_COUNT - 1;
+			}
+
+			if (binIndex < bestSplit)
+			{
+				++lo;
+			}
+			else
+			{
+				--hi;
+				u32 temp = indices[lo];
+				indices[lo] = indices[hi];
+				indices[hi] = temp;
+			}
+		}
+		mid = lo;
+	}
+	else if (count > builder->maxLeafSize)
+	{
+		// NOTE: every centroid coincides, SAH can't separate them so split by count
+		mid = first + count / 2;
+	}
+
+	if (mid == first || mid == first + count)
+	{
+		MakeBVHLeaf(&bvh->nodes[nodeIndex], first, count);
+		return;
+	}
+
+	u32 leftIndex = bvh->nodeCount;
+	bvh->nodeCount += 2;
+
+	BVHNode* node = &bvh->nodes[nodeIndex];
+	node->firstIndex = leftIndex;
+	node->primCount = 0;
+	node->splitAxis = (u16)bestAxis;
+
+	SubdivideBVHNode(builder, leftIndex, first, mid - first, depth + 1);
+	SubdivideBVHNode(builder, leftIndex + 1, mid, first + count - mid, depth + 1);
+}
+
+// NOTE: fills primIndices with the leaf order, leaves reference contiguous ranges of it. A leaf
+// costs a test per leafWidth primitives and holds up to the larger of leafWidth and BVH_MAX_LEAF_SIZE
+static BVH BuildBVH(AABB* primBounds, u32 primCount, u32* primIndices, u32 leafWidth)
+{
+	BVH bvh = {};
+	if (primCount == 0)
+	{
+		return bvh;
+	}
+
+	bvh.nodes = (BVHNode*)malloc(sizeof(BVHNode) * (2 * primCount - 1));
+	bvh.nodeCount = 1;
+
+	for (u32 i = 0; i < primCount; ++i)
+	{
+		primIndices[i] = i;
+	}
+
+	BVHBuilder builder;
+	builder.bvh = &bvh;
+	builder.primBounds = primBounds;
+	builder.primIndices = primIndices;
+	builder.leafWidth = leafWidth;
+	builder.maxLeafSize = MaxU32(BVH_MAX_LEAF_SIZE, leafWidth);
+	bvh.leafWidth = leafWidth;
+	SubdivideBVHNode(&builder, 0, 0, primCount, 0);
+	assert(bvh.depth <= BVH_MAX_DEPTH);
+
+	return bvh;
+}
+
+// NOTE: a lane that reaches a sphere leaf alone tests LANE_WIDTH spheres per pass, see IntersectSpheresWide,
+// so the 8 and 16-wide kernels get leaves as wide as their lanes. Narrower ones keep small leaves, full
+// 4-sphere leaves cost SSE2 more on the lanes that test one sphere at a time than the wide passes save
+static u32 GetSphereLeafWidth(u32 laneWidth)
+{
+	u32 result = (laneWidth > BVH_MAX_LEAF_SIZE) ? laneWidth : 1;
+	return result;
+}
+
+static void BuildSphereBVH(World* world, u32 laneWidth)
+{
+	u32 count = world->sphereCount;
+	AABB* bounds = (AABB*)malloc(sizeof(AABB) * count);
+	u32* indices = (u32*)malloc(sizeof(u32) * count);
+	for (u32 i = 0; i < count; ++i)
+	{
+		Sphere* sphere = &world->spheres[i];
+		f32 r = sphere->radius;
+		bounds[i].min = { sphere->pos.x - r, sphere->pos.y - r, sphere->pos.z - r };
+		bounds[i].max = { sphere->pos.x + r, sphere->pos.y + r, sphere->pos.z + r };
+	}
+
+	world->sphereBVH = BuildBVH(bounds, count, indices, GetSphereLeafWidth(laneWidth));
+
+	// NOTE: reorder the spheres themselves so leaves index them directly
+	Sphere* sorted = (Sphere*)malloc(sizeof(Sphere) * count);
+	for (u32 i = 0; i < count; ++i)
+	{
+		sorted[i] = world->spheres[indices[i]];
+	}
+	for (u32 i = 0; i < count; ++i)
+	{
+		world->spheres[i] = sorted[i];
+	}
+
+	free(sorted);
+	free(indices);
+	free(bounds);
+}
+
+static void BuildTriangleBVH(World* world)
+{
+	u32 count = world->triangleCount;
+	AABB* bounds = (AABB*)malloc(sizeof(AABB) * count);
+	u32* indices = (u32*)malloc(sizeof(u32) * count);
+	for (u32 i = 0; i < count; ++i)
+	{
+		Triangle* triangle = &world->triangles[i];
+		bounds[i] = EmptyAABB();
+		for (u32 corner = 0; corner < 3; ++corner)
+		{
+			bounds[i] = Union(bounds[i], world->vertices[triangle->vertexIndex[corner]]);
+		}
+	}
+
+	world->triangleBVH = BuildBVH(bounds, count, indices, 1);
+
+	Triangle* sorted = (Triangle*)malloc(sizeof(Triangle) * count);
+	for (u32 i = 0; i < count; ++i)
+	{
+		sorted[i] = world->triangles[indices[i]];
+	}
+	for (u32 i = 0; i < count; ++i)
+	{
+		world->triangles[i] = sorted[i];
+	}
+
+	free(sorted);
+	free(indices);
+	free(bounds);
+}
+
+#endif
@@ -0,0 +1,382 @@
+#if !defined RAY_CACHE_H
+# define RAY_CACHE_H
+
+//
+// Binary scene cache
+//
+// A prepared scene (BVHs built, primitives in leaf order, packed arrays filled) written out as
+// a header followed by the raw World arrays. Loading maps the file and points World straight
+// into it, nothing is parsed, copied or allocated per object.
+//
+// Layout, little endian, every section starts at a multiple of SCENE_CACHE_ALIGNMENT:
+//
+//   SceneCacheHeader
+//   Material[materialCount]
+//   Plane[planeCount]
+//   Sphere[sphereCount]
+//   vec3[vertexCount]
+//   Triangle[triangleCount]
+//   Light[lightCount]
+//   BVHNode[sphere node count]
+//   BVHNode[triangle node count]
+//   u32[] packed sphere / plane / material arrays, see BindWorldSoA
+//
+
+#define SCENE_CACHE_MAGIC 0x43594152 // "RAYC"
+// NOTE: bump whenever the header or any struct stored in a section changes
+#define SCENE_CACHE_VERSION 8
+#define SCENE_CACHE_ALIGNMENT 64
+
+struct SceneCacheSection
+{
+	u64 offset;
+	u64 count;
+};
+
+struct SceneCacheHeader
+{
+	u32 magic;
+	u32 version;
+	u32 headerSize;
+	u32 maxLaneWidth; // NOTE: the packed arrays are padded for it
+
+	u64 fileSize;
+
+	vec3 cameraPos;
+	vec3 cameraTarget;
+	u32 imageWidth;
+	u32 imageHeight;
+	u32 raysPerPixel;
+	u32 maxBounceCount;
+	u32 rouletteStartBounce;
+	f32 adaptiveThreshold;
+	u32 minRaysPerPixel;
+	u32 samplerKind;
+	char outputFileName[256];
+
+	SceneCacheSection materials;
+	SceneCacheSection planes;
+	SceneCacheSection spheres;
+	SceneCacheSection vertices;
+	SceneCacheSection triangles;
+	SceneCacheSection lights;
+	SceneCacheSection sphereNodes;
+	SceneCacheSection triangleNodes;
+	SceneCacheSection packed;
+
+	u32 sphereBVHDepth;
+	u32 triangleBVHDepth;
+	u32 sphereLeafWidth; // NOTE: the sphere leaves are sized for the kernel that wrote the cache
+	u32 triangleLeafWidth;
+};
+
+static bool IsSceneCacheFile(const char* fileName)
+{
+	bool result = false;
+
+	FILE* file = fopen(fileName, "rb");
+	if (file)
+	{
+		u32 magic = 0;
+		result = (fread(&magic, sizeof(magic), 1, file) == 1 && magic == SCENE_CACHE_MAGIC);
+		fclose(file);
+	}
+
+	return result;
+}
+
+static bool WriteCacheSection(FILE* file, SceneCacheSection* section, void* data, u64 count, size_t elementSize)
+{
+	static const u8 zeros[SCENE_CACHE_ALIGNMENT] = {};
+
+	i64 at = GetFilePosition(file);
+	size_t padding = (SCENE_CACHE_ALIGNMENT - (size_t)at % SCENE_CACHE_ALIGNMENT) % SCENE_CACHE_ALIGNMENT;
+	bool result = (at >= 0 && fwrite(zeros, 1, padding, file) == padding);
+
+	section->offset = (u64)at + padding;
+	section->count = count;
+	if (result && count)
+	{
+		result = (fwrite(data, elementSize, (size_t)count, file) == (size_t)count);
+	}
+
+	return result;
+}
+
+// NOTE: the world must already be prepared, the cache stores it exactly as the kernels see it
+static bool WriteSceneCache(Scene* scene, const char* fileName)
+{
+	World* world = &scene->world;
+
+	FILE* file = fopen(fileName, "wb");
+	if (!file)
+	{
+		fprintf(stderr, "[ERROR] Unable to create scene cache %s.\n", fileName);
+		return false;
+	}
+
+	SceneCacheHeader header = {};
+	header.magic = SCENE_CACHE_MAGIC;
+	header.version = SCENE_CACHE_VERSION;
+	header.headerSize = sizeof(SceneCacheHeader);
+	header.maxLaneWidth = MAX_LANE_WIDTH;
+	header.cameraPos = scene->cameraPos;
+	header.cameraTarget = scene->cameraTarget;
+	header.imageWidth = scene->imageWidth;
+	header.imageHeight = scene->imageHeight;
+	header.raysPerPixel = scene->raysPerPixel;
+	header.maxBounceCount = scene->maxBounceCount;
+	header.rouletteStartBounce = scene->rouletteStartBounce;
+	header.adaptiveThreshold = scene->adaptiveThreshold;
+	header.minRaysPerPixel = scene->minRaysPerPixel;
+	header.samplerKind = scene->samplerKind;
+	snprintf(header.outputFileName, sizeof(header.outputFileName), "%s", scene->outputFileName);
+	header.sphereBVHDepth = world->sphereBVH.depth;
+	header.triangleBVHDepth = world->triangleBVH.depth;
+	header.sphereLeafWidth = world->sphereBVH.leafWidth;
+	header.triangleLeafWidth = world->triangleBVH.leafWidth;
+
+	size_t packedCount = GetWorldSoASize(world) / sizeof(u32);
+
+	// NOTE: header goes in twice, the second time with the section offsets filled in
+	bool result = (fwrite(&header, sizeof(header), 1, file) == 1);
+	result = result && WriteCacheSection(file, &header.materials, world->materials, world->materialCount, sizeof(Material));
+	result = result && WriteCacheSection(file, &header.planes, world->planes, world->planeCount, sizeof(Plane));
+	result = result && WriteCacheSection(file, &header.spheres, world->spheres, world->sphereCount, sizeof(Sphere));
+	result = result && WriteCacheSection(file, &header.vertices, world->vertices, world->vertexCount, sizeof(vec3));
+	result = result && WriteCacheSection(file, &header.triangles, world->triangles, world->triangleCount, sizeof(Triangle));
+	result = result && WriteCacheSection(file, &header.lights, world->lights, world->lightCount, sizeof(Light));
+	result = result && WriteCacheSection(file, &header.sphereNodes, world->sphereBVH.nodes, world->sphereBVH.nodeCount, sizeof(BVHNode));
+	result = result && WriteCacheSection(file, &header.triangleNodes, world->triangleBVH.nodes, world->triangleBVH.nodeCount, sizeof(BVHNode));
+	result = result && WriteCacheSection(file, &header.packed, world->sphereSoA.x, packedCount, sizeof(u32));
+
+	if (result)
+	{
+		i64 size = GetFilePosition(file);
+		header.fileSize = (u64)size;
+		result = (size >= 0 && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1);
+	}
+	if (fclose(file) != 0)
+	{
+		result = false;
+	}
+
+	if (!result)
+	{
+		fprintf(stderr, "[ERROR] Unable to write scene cache %s.\n", fileName);
+	}
+
+	return result;
+}
+
+static bool IsValidCacheSection(SceneCacheHeader* header, SceneCacheSection* section, size_t elementSize)
+{
+	bool result = (section->offset % SCENE_CACHE_ALIGNMENT == 0 &&
+		section->offset <= header->fileSize &&
+		section->count <= (header->fileSize - section->offset) / elementSize);
+
+	return result;
+}
+
+static void* GetCacheSection(MappedFile* file, SceneCacheSection* section)
+{
+	void* result = 0;
+	if (section->count)
+	{
+		result = (u8*)file->contents + section->offset;
+	}
+
+	return result;
+}
+
+// NOTE: children come after their parent, as BuildBVH adds them, so the walk in index order can't
+// loop and has seen every parent of a node before the node itself
+static bool IsValidCacheBVH(BVH* bvh, u32 primCount)
+{
+	bool result = true;
+	u8* nodeDepths = (u8*)calloc(MaxU32(bvh->nodeCount, 1), sizeof(u8));
+	for (u32 nodeIndex = 0; result && nodeIndex < bvh->nodeCount; ++nodeIndex)
+	{
+		BVHNode* node = &bvh->nodes[nodeIndex];
+		if (node->primCount > 0)
+		{
+			result = ((u64)node->firstIndex + node->primCount <= primCount);
+		}
+		else
+		{
+			u32 childDepth = nodeDepths[nodeIndex] + 1u;
+			result = (node->firstIndex > nodeIndex && (u64)node->firstIndex + 1 < bvh->nodeCount &&
+				childDepth <= bvh->depth);
+			if (result)
+			{
+				nodeDepths[node->firstIndex] = (u8)MaxU32(nodeDepths[node->firstIndex], childDepth);
+				nodeDepths[node->firstIndex + 1] = (u8)MaxU32(nodeDepths[node->firstIndex + 1], childDepth);
+			}
+		}
+	}
+	free(nodeDepths);
+
+	return result;
+}
+
+static bool IsValidMatIndex(World* world, u32 matIndex)
+{
+	bool result = (matIndex < world->materialCount);
+	return result;
+}
+
+// NOTE: one pass over every index the kernels follow without a bounds check of their own, so a
+// damaged or hand edited cache is rejected here instead of reading out of bounds while rendering
+static bool IsValidCacheWorld(World* world)
+{
+	bool result = IsValidCacheBVH(&world->sphereBVH, world->sphereCount) &&
+		IsValidCacheBVH(&world->triangleBVH, world->triangleCount);
+
+	for (u32 planeIndex = 0; result && planeIndex < world->planeCount; ++planeIndex)
+	{
+		result = IsValidMatIndex(world, world->planes[planeIndex].matIndex) &&
+			IsValidMatIndex(world, world->planeSoA.matIndex[planeIndex]);
+	}
+	for (u32 sphereIndex = 0; result && sphereIndex < world->sphereCount; ++sphereIndex)
+	{
+		result = IsValidMatIndex(world, world->spheres[sphereIndex].matIndex) &&
+			IsValidMatIndex(world, world->sphereSoA.matIndex[sphereIndex]);
+	}
+	for (u32 triangleIndex = 0; result && triangleIndex < world->triangleCount; ++triangleIndex)
+	{
+		Triangle* triangle = &world->triangles[triangleIndex];
+		result = (IsValidMatIndex(world, triangle->matIndex) &&
+			triangle->vertexIndex[0] < world->vertexCount &&
+			triangle->vertexIndex[1] < world->vertexCount &&
+			triangle->vertexIndex[2] < world->vertexCount);
+	}
+	for (u32 matIndex = 0; result && matIndex < world->materialCount; ++matIndex)
+	{
+		u32 lightIndex = world->materials[matIndex].lightIndex;
+		u32 packedLightIndex = world->materialSoA.lightIndex[matIndex];
+		result = ((lightIndex == LIGHT_NONE || lightIndex < world->lightCount) &&
+			(packedLightIndex == LIGHT_NONE || packedLightIndex < world->lightCount));
+	}
+
+	return result;
+}
+
+static bool LoadSceneCache(Scene* scene, const char* fileName)
+{
+	MappedFile file = MapEntireFile(fileName);
+	if (!file.contents)
+	{
+		fprintf(stderr, "[ERROR] Unable to map scene cache %s.\n", fileName);
+		return false;
+	}
+
+	// NOTE: the header first, then every index in the sections once the world points into them
+	SceneCacheHeader* header = (SceneCacheHeader*)file.contents;
+	const char* error = 0;
+	if (file.size < sizeof(u32) || header->magic != SCENE_CACHE_MAGIC)
+	{
+		error = "not a scene cache";
+	}
+	else if (file.size < sizeof(SceneCacheHeader))
+	{
+		error = "truncated";
+	}
+	else if (header->version != SCENE_CACHE_VERSION || header->headerSize != sizeof(SceneCacheHeader) ||
+		header->maxLaneWidth != MAX_LANE_WIDTH)
+	{
+		error = "written by a different build, regenerate it";
+	}
+	else if (header->fileSize != file.size)
+	{
+		error = "truncated";
+	}
+	else if (header->materials.count == 0 || header->materials.count > U32_MAX ||
+		header->planes.count > U32_MAX || header->spheres.count > U32_MAX ||
+		header->vertices.count > U32_MAX || header->triangles.count > U32_MAX || header->lights.count > U32_MAX ||
+		header->sphereNodes.count > U32_MAX || header->triangleNodes.count > U32_MAX ||
+		!IsValidCacheSection(header, &header->materials, sizeof(Material)) ||
+		!IsValidCacheSection(header, &header->planes, sizeof(Plane)) ||
+		!IsValidCacheSection(header, &header->spheres, sizeof(Sphere)) ||
+		!IsValidCacheSection(header, &header->vertices, sizeof(vec3)) ||
+		!IsValidCacheSection(header, &header->triangles, sizeof(Triangle)) ||
+		!IsValidCacheSection(header, &header->lights, sizeof(Light)) ||
+		!IsValidCacheSection(header, &header->sphereNodes, sizeof(BVHNode)) ||
+		!IsValidCacheSection(header, &header->triangleNodes, sizeof(BVHNode)) ||
+		!IsValidCacheSection(header, &header->packed, sizeof(u32)))
+	{
+		error = "section out of bounds";
+	}
+	else if (header->sphereBVHDepth > BVH_MAX_DEPTH || header->triangleBVHDepth > BVH_MAX_DEPTH)
+	{
+		error = "BVH deeper than the traversal stack";
+	}
+
+	if (error)
+	{
+		fprintf(stderr, "[ERROR] Scene cache %s: %s.\n", fileName, error);
+		UnmapEntireFile(&file);
+		return false;
+	}
+
+	World* world = &scene->world;
+	*world = {};
+	world->materialCount = (u32)header->materials.count;
+	world->materials = (Material*)GetCacheSection(&file, &header->materials);
+	world->planeCount = (u32)header->planes.count;
+	world->planes = (Plane*)GetCacheSection(&file, &header->planes);
+	world->sphereCount = (u32)header->spheres.count;
+	world->spheres = (Sphere*)GetCacheSection(&file, &header->spheres);
+	world->vertexCount = (u32)header->vertices.count;
+	world->vertices = (vec3*)GetCacheSection(&file, &header->vertices);
+	world->triangleCount = (u32)header->triangles.count;
+	world->triangles = (Triangle*)GetCacheSection(&file, &header->triangles);
+	world->lightCount = (u32)header->lights.count;
+	world->lights = (Light*)GetCacheSection(&file, &header->lights);
+	world->sphereBVH.nodeCount = (u32)header->sphereNodes.count;
+	world->sphereBVH.nodes = (BVHNode*)GetCacheSection(&file, &header->sphereNodes);
+	world->sphereBVH.depth = header->sphereBVHDepth;
+	world->sphereBVH.leafWidth = header->sphereLeafWidth;
+	world->triangleBVH.nodeCount = (u32)header->triangleNodes.count;
+	world->triangleBVH.nodes = (BVHNode*)GetCacheSection(&file, &header->triangleNodes);
+	world->triangleBVH.depth = header->triangleBVHDepth;
+	world->triangleBVH.leafWidth = header->triangleLeafWidth;
+
+	if (header->packed.count * sizeof(u32) != GetWorldSoASize(world))
+	{
+		error = "packed arrays don't match the primitive counts";
+	}
+	else
+	{
+		BindWorldSoA(world, (u32*)GetCacheSection(&file, &header->packed));
+		if (!IsValidCacheWorld(world))
+		{
+			error = "section contents invalid";
+		}
+	}
+
+	if (error)
+	{
+		fprintf(stderr, "[ERROR] Scene cache %s: %s.\n", fileName, error);
+		*world = {};
+		UnmapEntireFile(&file);
+		return false;
+	}
+
+	scene->cameraPos = header->cameraPos;
+	scene->cameraTarget = header->cameraTarget;
+	scene->imageWidth = header->imageWidth;
+	scene->imageHeight = header->imageHeight;
+	scene->raysPerPixel = header->raysPerPixel;
+	scene->maxBounceCount = header->maxBounceCount;
+	scene->rouletteStartBounce = header->rouletteStartBounce;
+	scene->adaptiveThreshold = header->adaptiveThreshold;
+	scene->minRaysPerPixel = header->minRaysPerPixel;
+	scene->samplerKind = header->samplerKind;
+	free(scene->outputFileName);
+	scene->outputFileName = (char*)malloc(sizeof(header->outputFileName));
+	snprintf(scene->outputFileName, sizeof(header->outputFileName), "%.*s", (int)sizeof(header->outputFileName) - 1, header->outputFileName);
+
+	return true;
+}
+
+#endif
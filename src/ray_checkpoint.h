@@ -0,0 +1,195 @@
+#if !defined RAY_CHECKPOINT_H
+# define RAY_CHECKPOINT_H
+
+//
+// Render checkpoints
+//
+// The accumulation state of a progressive render after a whole number of passes: the settings and
+// scene it belongs to, the per-pixel color sums and ray counts, and the luminance sums and converged
+// flags adaptive sampling goes on from. The random numbers are a function of
+// pixel and sample index (see random_gen.h), so the rays done are all the generator state there is,
+// and a resumed render draws exactly the samples the uninterrupted one would have.
+//
+// Layout, little endian:
+//
+//   CheckpointHeader
+//   vec3[width * height]   linear color sums
+//   u32[width * height]    rays cast
+//   f32[width * height]    luminance sums
+//   f32[width * height]    luminance square sums
+//   u8[width * height]     converged, adaptive sampling stopped the pixel
+//
+
+#define CHECKPOINT_MAGIC 0x4B434152 // "RACK"
+// NOTE: bump whenever the header, the sample generation or what a sample estimates changes
+#define CHECKPOINT_VERSION 7
+// NOTE: a checkpointed render without --progressive goes in passes of this many rays per pixel
+#define CHECKPOINT_PASS_RAYS_PER_PIXEL 64
+#define CHECKPOINT_INTERVAL_SECONDS 60.0
+
+struct CheckpointHeader
+{
+	u32 magic;
+	u32 version;
+	u32 headerSize;
+	u32 laneWidth; // NOTE: the samples don't depend on it, but adaptive batches and the sphere BVH's leaves do
+
+	u64 sceneHash;
+	u32 imageWidth;
+	u32 imageHeight;
+	u32 passRaysPerPixel;
+	u32 maxBounceCount;
+	u32 rouletteStartBounce;
+	f32 adaptiveThreshold;
+	u32 minRaysPerPixel;
+	u32 samplerKind;
+
+	u32 passCount; // NOTE: passes completed
+	u32 raysPerPixelDone;
+};
+
+static u64 HashBytes(u64 hash, void* data, size_t size)
+{
+	// NOTE: FNV-1a
+	u8* at = (u8*)data;
+	for (size_t index = 0; index < size; ++index)
+	{
+		hash = (hash ^ at[index]) * 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+// NOTE: after PrepareWorld, the primitives are hashed in the order the BVH left them
+static u64 HashRenderScene(WorkQueue* queue)
+{
+	World* world = queue->world;
+
+	u64 result = 0xCBF29CE484222325ull;
+	result = HashBytes(result, &queue->camera, sizeof(Camera));
+	result = HashBytes(result, world->materials, sizeof(Material) * world->materialCount);
+	result = HashBytes(result, world->planes, sizeof(Plane) * world->planeCount);
+	result = HashBytes(result, world->spheres, sizeof(Sphere) * world->sphereCount);
+	result = HashBytes(result, world->vertices, sizeof(vec3) * world->vertexCount);
+	result = HashBytes(result, world->triangles, sizeof(Triangle) * world->triangleCount);
+
+	return result;
+}
+
+static CheckpointHeader MakeCheckpointHeader(WorkQueue* queue, u32 laneWidth, u32 passRaysPerPixel)
+{
+	CheckpointHeader result = {};
+	result.magic = CHECKPOINT_MAGIC;
+	result.version = CHECKPOINT_VERSION;
+	result.headerSize = sizeof(CheckpointHeader);
+	result.laneWidth = laneWidth;
+	result.sceneHash = HashRenderScene(queue);
+	result.imageWidth = queue->image.width;
+	result.imageHeight = queue->image.height;
+	result.passRaysPerPixel = passRaysPerPixel;
+	result.maxBounceCount = queue->maxBounceCount;
+	result.rouletteStartBounce = queue->rouletteStartBounce;
+	result.adaptiveThreshold = queue->adaptiveThreshold;
+	result.minRaysPerPixel = queue->minRaysPerPixel;
+	result.samplerKind = queue->samplerKind;
+
+	return result;
+}
+
+// NOTE: written next to the old checkpoint, synced and moved over it, so a job killed mid-write or a host
+// that goes down keeps either the old checkpoint or the whole new one
+static bool WriteCheckpoint(WorkQueue* queue, CheckpointHeader* header, const char* fileName)
+{
+	char tempFileName[4096];
+	snprintf(tempFileName, sizeof(tempFileName), "%s.tmp", fileName);
+
+	FILE* file = fopen(tempFileName, "wb");
+	if (!file)
+	{
+		fprintf(stderr, "[ERROR] Unable to create checkpoint %s.\n", tempFileName);
+		return false;
+	}
+
+	size_t pixelTotal = (size_t)queue->image.width * queue->image.height;
+	bool result = (fwrite(header, sizeof(CheckpointHeader), 1, file) == 1 &&
+		fwrite(queue->accumulation, sizeof(vec3), pixelTotal, file) == pixelTotal &&
+		fwrite(queue->sampleCounts, sizeof(u32), pixelTotal, file) == pixelTotal &&
+		fwrite(queue->luminanceSums, sizeof(f32), pixelTotal, file) == pixelTotal &&
+		fwrite(queue->luminanceSqSums, sizeof(f32), pixelTotal, file) == pixelTotal &&
+		fwrite(queue->converged, sizeof(u8), pixelTotal, file) == pixelTotal &&
+		SyncFile(file));
+	if (fclose(file) != 0)
+	{
+		result = false;
+	}
+
+	result = result && ReplaceFileWith(fileName, tempFileName);
+	if (!result)
+	{
+		fprintf(stderr, "[ERROR] Unable to write checkpoint %s.\n", fileName);
+	}
+
+	return result;
+}
+
+// NOTE: expected carries the settings of this run, on success it also has the progress of the checkpoint
+static bool LoadCheckpoint(WorkQueue* queue, CheckpointHeader* expected, const char* fileName)
+{
+	FILE* file = fopen(fileName, "rb");
+	if (!file)
+	{
+		fprintf(stderr, "[ERROR] Unable to read checkpoint %s.\n", fileName);
+		return false;
+	}
+
+	CheckpointHeader header = {};
+	const char* error = 0;
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != CHECKPOINT_MAGIC)
+	{
+		error = "not a checkpoint";
+	}
+	else if (header.version != CHECKPOINT_VERSION || header.headerSize != sizeof(CheckpointHeader))
+	{
+		error = "written by a different build";
+	}
+	else if (header.laneWidth != expected->laneWidth)
+	{
+		error = "rendered with a different lane width, pass the same --lanes";
+	}
+	else if (header.sceneHash != expected->sceneHash || header.imageWidth != expected->imageWidth ||
+		header.imageHeight != expected->imageHeight)
+	{
+		error = "rendered from a different scene, camera or image size";
+	}
+	else if (header.passRaysPerPixel != expected->passRaysPerPixel || header.maxBounceCount != expected->maxBounceCount ||
+		header.rouletteStartBounce != expected->rouletteStartBounce ||
+		header.adaptiveThreshold != expected->adaptiveThreshold || header.minRaysPerPixel != expected->minRaysPerPixel ||
+		header.samplerKind != expected->samplerKind)
+	{
+		error = "rendered with different pass, bounce, adaptive or sampler settings";
+	}
+
+	size_t pixelTotal = (size_t)queue->image.width * queue->image.height;
+	if (!error && (fread(queue->accumulation, sizeof(vec3), pixelTotal, file) != pixelTotal ||
+		fread(queue->sampleCounts, sizeof(u32), pixelTotal, file) != pixelTotal ||
+		fread(queue->luminanceSums, sizeof(f32), pixelTotal, file) != pixelTotal ||
+		fread(queue->luminanceSqSums, sizeof(f32), pixelTotal, file) != pixelTotal ||
+		fread(queue->converged, sizeof(u8), pixelTotal, file) != pixelTotal))
+	{
+		error = "truncated";
+	}
+	fclose(file);
+
+	if (error)
+	{
+		fprintf(stderr, "[ERROR] Checkpoint %s: %s.\n", fileName, error);
+		return false;
+	}
+
+	expected->passCount = header.passCount;
+	expected->raysPerPixelDone = header.raysPerPixelDone;
+
+	return true;
+}
+
+#endif
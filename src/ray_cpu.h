@@ -0,0 +1,84 @@
+#if !defined RAY_CPU_H
+# define RAY_CPU_H
+
+//
+// CPU feature detection for picking the sample kernel
+//
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void Cpuid(u32 leaf, u32 subleaf, u32* regs)
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, (int)leaf, (int)subleaf);
+	regs[0] = (u32)info[0];
+	regs[1] = (u32)info[1];
+	regs[2] = (u32)info[2];
+	regs[3] = (u32)info[3];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64 GetEnabledXStateMask()
+{
+#if defined(_MSC_VER)
+	u64 result = _xgetbv(0);
+#else
+	u32 lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	u64 result = ((u64)hi << 32) | lo;
+#endif
+
+	return result;
+}
+
+// NOTE: the instruction set alone isn't enough, the OS must also save the wide registers (XCR0)
+static u32 GetWidestLaneWidth()
+{
+	u32 regs[4];
+	Cpuid(0, 0, regs);
+	u32 maxLeaf = regs[0];
+
+	Cpuid(1, 0, regs);
+	bool sse2 = (regs[3] & (1 << 26)) != 0;
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0;
+	bool fma = (regs[2] & (1 << 12)) != 0;
+
+	bool avx2 = false;
+	bool avx512 = false;
+	if (maxLeaf >= 7 && osxsave && avx)
+	{
+		u64 xcr0 = GetEnabledXStateMask();
+		bool ymmState = (xcr0 & 0x6) == 0x6;
+		bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+		Cpuid(7, 0, regs);
+		avx2 = ymmState && fma && (regs[1] & (1 << 5)) != 0;
+		avx512 = zmmState && avx2 && (regs[1] & (1 << 16)) != 0;
+	}
+
+	u32 result = 1;
+	if (avx512)
+	{
+		result = 16;
+	}
+	else if (avx2)
+	{
+		result = 8;
+	}
+	else if (sse2)
+	{
+		result = 4;
+	}
+
+	return result;
+}
+
+#endif
@@ -0,0 +1,538 @@
+#if !defined RAY_INTERSECT_H
+# define RAY_INTERSECT_H
+
+//
+// Lane-wide intersection
+//
+
+static lane_u32 RayIntersectsAABB(AABB* box, lane_v3 rayOrigin, lane_v3 invDir, lane_f32 hitDist)
+{
+	lane_f32 tx0 = (LaneF32FromF32(box->min.x) - rayOrigin.x) * invDir.x;
+	lane_f32 tx1 = (LaneF32FromF32(box->max.x) - rayOrigin.x) * invDir.x;
+	lane_f32 ty0 = (LaneF32FromF32(box->min.y) - rayOrigin.y) * invDir.y;
+	lane_f32 ty1 = (LaneF32FromF32(box->max.y) - rayOrigin.y) * invDir.y;
+	lane_f32 tz0 = (LaneF32FromF32(box->min.z) - rayOrigin.z) * invDir.z;
+	lane_f32 tz1 = (LaneF32FromF32(box->max.z) - rayOrigin.z) * invDir.z;
+
+	lane_f32 tNear = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Min(tz0, tz1));
+	lane_f32 tFar = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Max(tz0, tz1));
+
+	lane_u32 result = (Max(tNear, LaneF32FromF32(0.0f)) <= tFar) & (tNear < hitDist);
+
+	return result;
+}
+
+// NOTE: nearer root of the ray/sphere quadratic that lies past MIN_HIT_DIST, rootMask flags lanes with two distinct roots
+static lane_f32 SphereHitDistance(lane_v3 sphereRelRayOrigin, lane_v3 rayDir, lane_f32 sphereRadius, lane_u32* rootMask)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+	lane_f32 epsilon = LaneF32FromF32(HIT_EPSILON);
+
+	lane_f32 a = Dot(rayDir, rayDir);
+	lane_f32 b = 2.0f * Dot(rayDir, sphereRelRayOrigin);
+	lane_f32 c = Dot(sphereRelRayOrigin, sphereRelRayOrigin) - sphereRadius * sphereRadius;
+
+	lane_f32 d = SquareRoot(b * b - 4.0f * a * c);
+	*rootMask = d > epsilon;
+
+	lane_f32 denom = 2.0f * a;
+	lane_f32 tp = (-b + d) / denom;
+	lane_f32 tn = (-b - d) / denom;
+
+	lane_f32 result = tp;
+	lane_u32 pickMask = (tn > minHitDist) & (tn < tp);
+	ConditionalAssign(&result, pickMask, tn);
+
+	return result;
+}
+
+// NOTE: planes are unbounded and stay a flat list, every lane's ray against every one of them
+static void IntersectPlanes(PlaneSoA* planes, u32 count, lane_v3 rayOrigin, lane_v3 rayDir,
+	lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+	lane_f32 epsilon = LaneF32FromF32(HIT_EPSILON);
+
+	for (u32 planeIndex = 0; planeIndex < count; ++planeIndex)
+	{
+		lane_v3 planeN = Vec3(planes->nx[planeIndex], planes->ny[planeIndex], planes->nz[planeIndex]);
+		lane_f32 planeDist = LaneF32FromF32(planes->dist[planeIndex]);
+
+		lane_f32 denom = Dot(planeN, rayDir);
+		lane_u32 denomMask = ((denom < -epsilon) | (denom > epsilon));
+		if (!MaskIsZero(denomMask))
+		{
+			lane_f32 t = (-planeDist - Dot(planeN, rayOrigin)) / denom;
+			lane_u32 tMask = ((t > minHitDist) & (t < *hitDist));
+			lane_u32 hitMask = denomMask & tMask;
+			if (!MaskIsZero(hitMask))
+			{
+				lane_u32 planeMatIndex = LaneU32FromU32(planes->matIndex[planeIndex]);
+				ConditionalAssign(hitDist, hitMask, t);
+				ConditionalAssign(hitMaterial, hitMask, planeMatIndex);
+				ConditionalAssign(nextNormal, hitMask, planeN);
+			}
+		}
+	}
+}
+
+// NOTE: every lane's ray against one sphere at a time
+static void IntersectSpheres(SphereSoA* spheres, u32 first, u32 count, lane_v3 rayOrigin, lane_v3 rayDir, lane_u32 laneMask,
+	lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+
+	for (u32 sphereIndex = first; sphereIndex < first + count; ++sphereIndex)
+	{
+		lane_v3 spherePos = Vec3(spheres->x[sphereIndex], spheres->y[sphereIndex], spheres->z[sphereIndex]);
+		lane_f32 sphereRadius = LaneF32FromF32(spheres->radius[sphereIndex]);
+
+		lane_v3 sphereRelRayOrigin = rayOrigin - spherePos;
+		lane_u32 rootMask;
+		lane_f32 t = SphereHitDistance(sphereRelRayOrigin, rayDir, sphereRadius, &rootMask);
+
+		lane_u32 hitMask = laneMask & rootMask & (t > minHitDist) & (t < *hitDist);
+		if (!MaskIsZero(hitMask))
+		{
+			lane_u32 sphereMatIndex = LaneU32FromU32(spheres->matIndex[sphereIndex]);
+			ConditionalAssign(hitDist, hitMask, t);
+			ConditionalAssign(hitMaterial, hitMask, sphereMatIndex);
+			ConditionalAssign(nextNormal, hitMask, VecNormalize(t * rayDir + sphereRelRayOrigin));
+		}
+	}
+}
+
+// NOTE: one lane's ray against LANE_WIDTH spheres at a time, cheaper than the loop above once few lanes are alive
+static void IntersectSpheresWide(SphereSoA* spheres, u32 first, u32 count, lane_v3 rayOrigin, lane_v3 rayDir, lane_u32 laneMask,
+	lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+	lane_u32 end = LaneU32FromU32(first + count);
+
+	for (u32 laneIndex = 0; laneIndex < LANE_WIDTH; ++laneIndex)
+	{
+		if (ExtractLane(laneMask, laneIndex) == 0)
+		{
+			continue;
+		}
+
+		vec3 origin = ExtractLane(rayOrigin, laneIndex);
+		vec3 dir = ExtractLane(rayDir, laneIndex);
+		lane_v3 wideOrigin = LaneV3FromV3(origin);
+		lane_v3 wideDir = LaneV3FromV3(dir);
+
+		f32 closest = ExtractLane(*hitDist, laneIndex);
+		u32 closestIndex = U32_MAX;
+		for (u32 base = first; base < first + count; base += LANE_WIDTH)
+		{
+			lane_u32 validMask = (LaneIndices() + LaneU32FromU32(base)) < end;
+			lane_v3 spherePos = LaneV3(LoadLaneF32(spheres->x + base), LoadLaneF32(spheres->y + base), LoadLaneF32(spheres->z + base));
+			lane_f32 sphereRadius = LoadLaneF32(spheres->radius + base);
+
+			lane_u32 rootMask;
+			lane_f32 t = SphereHitDistance(wideOrigin - spherePos, wideDir, sphereRadius, &rootMask);
+
+			lane_u32 hitMask = validMask & rootMask & (t > minHitDist) & (t < LaneF32FromF32(closest));
+			if (!MaskIsZero(hitMask))
+			{
+				lane_f32 hitT = LaneF32FromF32(FLT_MAX);
+				ConditionalAssign(&hitT, hitMask, t);
+				closest = HorizontalMin(hitT);
+				for (u32 sphereLane = 0; sphereLane < LANE_WIDTH; ++sphereLane)
+				{
+					if (ExtractLane(hitT, sphereLane) == closest)
+					{
+						closestIndex = base + sphereLane;
+						break;
+					}
+				}
+			}
+		}
+
+		if (closestIndex != U32_MAX)
+		{
+			// NOTE: the same operations as VecNormalize(t * rayDir + sphereRelRayOrigin) in IntersectSpheres,
+			// so a hit's normal doesn't depend on which of the two tested it
+			f32 nx = closest * dir.x + (origin.x - spheres->x[closestIndex]);
+			f32 ny = closest * dir.y + (origin.y - spheres->y[closestIndex]);
+			f32 nz = closest * dir.z + (origin.z - spheres->z[closestIndex]);
+			f32 lengthSq = nx * nx + ny * ny + nz * nz;
+			vec3 normal = {};
+			if (lengthSq > Square(0.0001f))
+			{
+				f32 invLength = 1.0f / SquareRoot(lengthSq);
+				normal = { nx * invLength, ny * invLength, nz * invLength };
+			}
+
+			SetLane(hitDist, laneIndex, closest);
+			SetLane(hitMaterial, laneIndex, spheres->matIndex[closestIndex]);
+			SetLane(nextNormal, laneIndex, normal);
+		}
+	}
+}
+
+// NOTE: Moller-Trumbore, the normal is flipped to face the ray so meshes render regardless of winding
+static void IntersectTriangles(Triangle* triangles, vec3* vertices, u32 first, u32 count, lane_v3 rayOrigin, lane_v3 rayDir,
+	lane_u32 laneMask, lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+	// NOTE: det scales with triangle area, so this only rejects rays parallel to the plane
+	lane_f32 epsilon = LaneF32FromF32(1e-12f);
+
+	for (u32 triangleIndex = first; triangleIndex < first + count; ++triangleIndex)
+	{
+		Triangle* triangle = &triangles[triangleIndex];
+
+		lane_v3 v0 = LaneV3FromV3(vertices[triangle->vertexIndex[0]]);
+		lane_v3 v1 = LaneV3FromV3(vertices[triangle->vertexIndex[1]]);
+		lane_v3 v2 = LaneV3FromV3(vertices[triangle->vertexIndex[2]]);
+		lane_v3 edge1 = v1 - v0;
+		lane_v3 edge2 = v2 - v0;
+
+		lane_v3 p = Cross(rayDir, edge2);
+		lane_f32 det = Dot(edge1, p);
+		lane_u32 detMask = laneMask & ((det < -epsilon) | (det > epsilon));
+		if (MaskIsZero(detMask))
+		{
+			continue;
+		}
+
+		lane_f32 invDet = 1.0f / det;
+		lane_v3 s = rayOrigin - v0;
+		lane_f32 u = Dot(s, p) * invDet;
+		lane_v3 q = Cross(s, edge1);
+		lane_f32 v = Dot(rayDir, q) * invDet;
+		lane_f32 t = Dot(edge2, q) * invDet;
+
+		lane_f32 zero = LaneF32FromF32(0.0f);
+		lane_u32 hitMask = detMask & (u >= zero) & (v >= zero) & ((u + v) <= LaneF32FromF32(1.0f)) &
+			(t > minHitDist) & (t < *hitDist);
+		if (!MaskIsZero(hitMask))
+		{
+			lane_v3 normal = VecNormalize(Cross(edge1, edge2));
+			ConditionalAssign(&normal, Dot(normal, rayDir) > zero, -normal);
+
+			lane_u32 triangleMatIndex = LaneU32FromU32(triangle->matIndex);
+			ConditionalAssign(hitDist, hitMask, t);
+			ConditionalAssign(hitMaterial, hitMask, triangleMatIndex);
+			ConditionalAssign(nextNormal, hitMask, normal);
+		}
+	}
+}
+
+static void IntersectLeaf(SphereSoA* spheres, Triangle* triangles, vec3* vertices, u32 primitiveType, BVHNode* node,
+	lane_u32 boxMask, lane_v3 rayOrigin, lane_v3 rayDir, lane_u32 laneMask, lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	if (primitiveType == PRIMITIVE_TRIANGLE)
+	{
+		IntersectTriangles(triangles, vertices, node->firstIndex, node->primCount, rayOrigin, rayDir, laneMask,
+			hitDist, hitMaterial, nextNormal);
+	}
+	else
+	{
+		// NOTE: per-lane passes over the leaf beat per-sphere passes when few lanes reached it
+		u32 widePasses = MaskLaneCount(boxMask) * ((node->primCount + LANE_WIDTH - 1) / LANE_WIDTH);
+		if (widePasses < node->primCount)
+		{
+			IntersectSpheresWide(spheres, node->firstIndex, node->primCount, rayOrigin, rayDir, boxMask,
+				hitDist, hitMaterial, nextNormal);
+		}
+		else
+		{
+			IntersectSpheres(spheres, node->firstIndex, node->primCount, rayOrigin, rayDir, laneMask,
+				hitDist, hitMaterial, nextNormal);
+		}
+	}
+}
+
+// NOTE: the subtree below rootIndex, 0 for the whole BVH
+static void IntersectBVH(World* world, BVH* bvh, u32 rootIndex, u32 primitiveType, lane_v3 rayOrigin, lane_v3 rayDir, lane_u32 laneMask,
+	lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	if (bvh->nodeCount == 0)
+	{
+		return;
+	}
+
+	lane_v3 invDir = LaneV3(1.0f / rayDir.x, 1.0f / rayDir.y, 1.0f / rayDir.z);
+	// NOTE: children are ordered by the first lane, rays of one pixel mostly agree after the first bounce anyway
+	vec3 dirSign = Extract0(rayDir);
+
+	u32 stack[BVH_STACK_SIZE];
+	u32 stackCount = 0;
+	stack[stackCount++] = rootIndex;
+	while (stackCount > 0)
+	{
+		BVHNode* node = &bvh->nodes[stack[--stackCount]];
+		lane_u32 boxMask = laneMask & RayIntersectsAABB(&node->bounds, rayOrigin, invDir, *hitDist);
+		if (MaskIsZero(boxMask))
+		{
+			continue;
+		}
+
+		if (node->primCount > 0)
+		{
+			IntersectLeaf(&world->sphereSoA, world->triangles, world->vertices, primitiveType, node, boxMask,
+				rayOrigin, rayDir, laneMask, hitDist, hitMaterial, nextNormal);
+		}
+		else
+		{
+			assert(stackCount + 2 <= BVH_STACK_SIZE);
+			u32 nearChild = node->firstIndex;
+			u32 farChild = node->firstIndex + 1;
+			if (AxisValue(dirSign, node->splitAxis) < 0.0f)
+			{
+				nearChild = node->firstIndex + 1;
+				farChild = node->firstIndex;
+			}
+			stack[stackCount++] = farChild;
+			stack[stackCount++] = nearChild;
+		}
+	}
+}
+
+// NOTE: closest hit over everything in the world, hitDist caps the search
+static void IntersectWorld(World* world, lane_v3 rayOrigin, lane_v3 rayDir, lane_u32 laneMask,
+	lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	IntersectPlanes(&world->planeSoA, world->planeCount, rayOrigin, rayDir, hitDist, hitMaterial, nextNormal);
+	IntersectBVH(world, &world->sphereBVH, 0, PRIMITIVE_SPHERE, rayOrigin, rayDir, laneMask, hitDist, hitMaterial, nextNormal);
+	IntersectBVH(world, &world->triangleBVH, 0, PRIMITIVE_TRIANGLE, rayOrigin, rayDir, laneMask, hitDist, hitMaterial, nextNormal);
+}
+
+// NOTE: a packet's nodes in the order they were collected, cut down leaves from the packet's copies of
+// the primitives and whole subtrees from the world
+static void IntersectPacketNodes(World* world, BVH* bvh, PacketNodes* nodes, SphereSoA* spheres, Triangle* triangles,
+	u32 primitiveType, lane_v3 rayOrigin, lane_v3 rayDir, lane_u32 laneMask, lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	lane_v3 invDir = LaneV3(1.0f / rayDir.x, 1.0f / rayDir.y, 1.0f / rayDir.z);
+	for (u32 nodeIndex = 0; nodeIndex < nodes->nodeCount; ++nodeIndex)
+	{
+		BVHNode* node = &nodes->nodes[nodeIndex];
+		lane_u32 boxMask = laneMask & RayIntersectsAABB(&node->bounds, rayOrigin, invDir, *hitDist);
+		if (MaskIsZero(boxMask))
+		{
+			continue;
+		}
+
+		if (node->primCount > 0)
+		{
+			IntersectLeaf(spheres, triangles, world->vertices, primitiveType, node, boxMask,
+				rayOrigin, rayDir, laneMask, hitDist, hitMaterial, nextNormal);
+		}
+		else
+		{
+			IntersectBVH(world, bvh, node->firstIndex, primitiveType, rayOrigin, rayDir, laneMask, hitDist, hitMaterial, nextNormal);
+		}
+	}
+}
+
+// NOTE: IntersectWorld for camera rays of the block the packet was built for, see ray_packet.h
+static void IntersectCameraRays(World* world, RayPacket* packet, lane_v3 rayOrigin, lane_v3 rayDir, lane_u32 laneMask,
+	lane_f32* hitDist, lane_u32* hitMaterial, lane_v3* nextNormal)
+{
+	IntersectPlanes(&packet->planes, packet->planeCount, rayOrigin, rayDir, hitDist, hitMaterial, nextNormal);
+	IntersectPacketNodes(world, &world->sphereBVH, &packet->sphereNodes, &packet->spheres, 0, PRIMITIVE_SPHERE,
+		rayOrigin, rayDir, laneMask, hitDist, hitMaterial, nextNormal);
+	IntersectPacketNodes(world, &world->triangleBVH, &packet->triangleNodes, 0, packet->triangles, PRIMITIVE_TRIANGLE,
+		rayOrigin, rayDir, laneMask, hitDist, hitMaterial, nextNormal);
+}
+
+//
+// Lane-wide occlusion
+//
+// Any hit instead of the closest one, for shadow rays and other visibility queries: no normals, no
+// materials, maxDist never shrinks, and openMask drops a lane the moment something blocks it, so
+// traversal stops as soon as every lane has been answered.
+//
+
+static void OccludedPlanes(PlaneSoA* planes, u32 count, lane_v3 rayOrigin, lane_v3 rayDir, lane_f32 maxDist,
+	lane_u32* openMask)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+	lane_f32 epsilon = LaneF32FromF32(HIT_EPSILON);
+
+	for (u32 planeIndex = 0; planeIndex < count && !MaskIsZero(*openMask); ++planeIndex)
+	{
+		lane_v3 planeN = Vec3(planes->nx[planeIndex], planes->ny[planeIndex], planes->nz[planeIndex]);
+		lane_f32 planeDist = LaneF32FromF32(planes->dist[planeIndex]);
+
+		lane_f32 denom = Dot(planeN, rayDir);
+		lane_f32 t = (-planeDist - Dot(planeN, rayOrigin)) / denom;
+		lane_u32 hitMask = ((denom < -epsilon) | (denom > epsilon)) & (t > minHitDist) & (t < maxDist);
+		*openMask = AndNot(hitMask, *openMask);
+	}
+}
+
+static void OccludedSpheres(SphereSoA* spheres, u32 first, u32 count, lane_v3 rayOrigin, lane_v3 rayDir, lane_f32 maxDist,
+	lane_u32* openMask)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+
+	for (u32 sphereIndex = first; sphereIndex < first + count && !MaskIsZero(*openMask); ++sphereIndex)
+	{
+		lane_v3 spherePos = Vec3(spheres->x[sphereIndex], spheres->y[sphereIndex], spheres->z[sphereIndex]);
+		lane_f32 sphereRadius = LaneF32FromF32(spheres->radius[sphereIndex]);
+
+		lane_u32 rootMask;
+		lane_f32 t = SphereHitDistance(rayOrigin - spherePos, rayDir, sphereRadius, &rootMask);
+		lane_u32 hitMask = rootMask & (t > minHitDist) & (t < maxDist);
+		*openMask = AndNot(hitMask, *openMask);
+	}
+}
+
+// NOTE: one lane's ray against LANE_WIDTH spheres at a time, the lane is done at the first pass that hits
+static void OccludedSpheresWide(SphereSoA* spheres, u32 first, u32 count, lane_v3 rayOrigin, lane_v3 rayDir, lane_f32 maxDist,
+	lane_u32* openMask)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+	lane_u32 end = LaneU32FromU32(first + count);
+
+	for (u32 laneIndex = 0; laneIndex < LANE_WIDTH; ++laneIndex)
+	{
+		if (ExtractLane(*openMask, laneIndex) == 0)
+		{
+			continue;
+		}
+
+		lane_v3 wideOrigin = LaneV3FromV3(ExtractLane(rayOrigin, laneIndex));
+		lane_v3 wideDir = LaneV3FromV3(ExtractLane(rayDir, laneIndex));
+		lane_f32 wideMaxDist = LaneF32FromF32(ExtractLane(maxDist, laneIndex));
+
+		for (u32 base = first; base < first + count; base += LANE_WIDTH)
+		{
+			lane_u32 validMask = (LaneIndices() + LaneU32FromU32(base)) < end;
+			lane_v3 spherePos = LaneV3(LoadLaneF32(spheres->x + base), LoadLaneF32(spheres->y + base), LoadLaneF32(spheres->z + base));
+			lane_f32 sphereRadius = LoadLaneF32(spheres->radius + base);
+
+			lane_u32 rootMask;
+			lane_f32 t = SphereHitDistance(wideOrigin - spherePos, wideDir, sphereRadius, &rootMask);
+
+			lane_u32 hitMask = validMask & rootMask & (t > minHitDist) & (t < wideMaxDist);
+			if (!MaskIsZero(hitMask))
+			{
+				SetLane(openMask, laneIndex, 0);
+				break;
+			}
+		}
+	}
+}
+
+static void OccludedTriangles(World* world, u32 first, u32 count, lane_v3 rayOrigin, lane_v3 rayDir, lane_f32 maxDist,
+	lane_u32* openMask)
+{
+	lane_f32 minHitDist = LaneF32FromF32(MIN_HIT_DIST);
+	lane_f32 epsilon = LaneF32FromF32(1e-12f);
+	lane_f32 zero = LaneF32FromF32(0.0f);
+
+	for (u32 triangleIndex = first; triangleIndex < first + count && !MaskIsZero(*openMask); ++triangleIndex)
+	{
+		Triangle* triangle = &world->triangles[triangleIndex];
+
+		lane_v3 v0 = LaneV3FromV3(world->vertices[triangle->vertexIndex[0]]);
+		lane_v3 edge1 = LaneV3FromV3(world->vertices[triangle->vertexIndex[1]]) - v0;
+		lane_v3 edge2 = LaneV3FromV3(world->vertices[triangle->vertexIndex[2]]) - v0;
+
+		lane_v3 p = Cross(rayDir, edge2);
+		lane_f32 det = Dot(edge1, p);
+		lane_u32 detMask = *openMask & ((det < -epsilon) | (det > epsilon));
+		if (MaskIsZero(detMask))
+		{
+			continue;
+		}
+
+		lane_f32 invDet = 1.0f / det;
+		lane_v3 s = rayOrigin - v0;
+		lane_f32 u = Dot(s, p) * invDet;
+		lane_v3 q = Cross(s, edge1);
+		lane_f32 v = Dot(rayDir, q) * invDet;
+		lane_f32 t = Dot(edge2, q) * invDet;
+
+		lane_u32 hitMask = detMask & (u >= zero) & (v >= zero) & ((u + v) <= LaneF32FromF32(1.0f)) &
+			(t > minHitDist) & (t < maxDist);
+		*openMask = AndNot(hitMask, *openMask);
+	}
+}
+
+static void OccludedBVH(World* world, BVH* bvh, u32 primitiveType, lane_v3 rayOrigin, lane_v3 rayDir, lane_f32 maxDist,
+	lane_u32* openMask)
+{
+	if (bvh->nodeCount == 0 || MaskIsZero(*openMask))
+	{
+		return;
+	}
+
+	lane_v3 invDir = LaneV3(1.0f / rayDir.x, 1.0f / rayDir.y, 1.0f / rayDir.z);
+	vec3 dirSign = Extract0(rayDir);
+
+	u32 stack[BVH_STACK_SIZE];
+	u32 stackCount = 0;
+	stack[stackCount++] = 0;
+	while (stackCount > 0)
+	{
+		BVHNode* node = &bvh->nodes[stack[--stackCount]];
+		lane_u32 boxMask = *openMask & RayIntersectsAABB(&node->bounds, rayOrigin, invDir, maxDist);
+		if (MaskIsZero(boxMask))
+		{
+			continue;
+		}
+
+		if (node->primCount > 0)
+		{
+			// NOTE: lanes that missed the box keep their answer, only the ones that reached the leaf are tested
+			lane_u32 leafMask = boxMask;
+			if (primitiveType == PRIMITIVE_TRIANGLE)
+			{
+				OccludedTriangles(world, node->firstIndex, node->primCount, rayOrigin, rayDir, maxDist, &leafMask);
+			}
+			else if (MaskLaneCount(boxMask) * ((node->primCount + LANE_WIDTH - 1) / LANE_WIDTH) < node->primCount)
+			{
+				OccludedSpheresWide(&world->sphereSoA, node->firstIndex, node->primCount, rayOrigin, rayDir, maxDist, &leafMask);
+			}
+			else
+			{
+				OccludedSpheres(&world->sphereSoA, node->firstIndex, node->primCount, rayOrigin, rayDir, maxDist, &leafMask);
+			}
+
+			*openMask = AndNot(AndNot(leafMask, boxMask), *openMask);
+			if (MaskIsZero(*openMask))
+			{
+				return;
+			}
+		}
+		else
+		{
+			assert(stackCount + 2 <= BVH_STACK_SIZE);
+			u32 nearChild = node->firstIndex;
+			u32 farChild = node->firstIndex + 1;
+			if (AxisValue(dirSign, node->splitAxis) < 0.0f)
+			{
+				nearChild = node->firstIndex + 1;
+				farChild = node->firstIndex;
+			}
+			stack[stackCount++] = farChild;
+			stack[stackCount++] = nearChild;
+		}
+	}
+}
+
+// NOTE: lanes of laneMask with anything in the way closer than maxDist, the any-hit twin of IntersectWorld
+static lane_u32 OccludeWorld(World* world, lane_v3 rayOrigin, lane_v3 rayDir, lane_f32 maxDist, lane_u32 laneMask)
+{
+	lane_u32 openMask = laneMask;
+	OccludedPlanes(&world->planeSoA, world->planeCount, rayOrigin, rayDir, maxDist, &openMask);
+	OccludedBVH(world, &world->sphereBVH, PRIMITIVE_SPHERE, rayOrigin, rayDir, maxDist, &openMask);
+	OccludedBVH(world, &world->triangleBVH, PRIMITIVE_TRIANGLE, rayOrigin, rayDir, maxDist, &openMask);
+
+	lane_u32 result = AndNot(openMask, laneMask);
+	return result;
+}
+
+// NOTE: lanes of laneMask with nothing in the way closer than maxDist
+static lane_u32 IsUnoccluded(World* world, lane_v3 rayOrigin, lane_v3 rayDir, lane_f32 maxDist, lane_u32 laneMask)
+{
+	lane_u32 result = AndNot(OccludeWorld(world, rayOrigin, rayDir, maxDist, laneMask), laneMask);
+	return result;
+}
+
+#endif
@@ -0,0 +1,167 @@
+#if !defined RAY_KERNEL_H
+# define RAY_KERNEL_H
+
+//
+// Sample kernel, compiled once per lane backend
+//
+// NOTE: the including translation unit defines LANE_WIDTH, LANE_NAMESPACE, CAST_SAMPLE_RAYS and
+// CAST_BLOCK_RAYS and gets built with the matching instruction set flags.
+// Everything lane-typed lives in LANE_NAMESPACE so the backends can link together.
+//
+
+#include "ray_types.h"
+#include "ray.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+namespace LANE_NAMESPACE
+{
+
+#include "ray_lane.h"
+#include "ray_math.h"
+#include "random_gen.h"
+#include "ray_sampler.h"
+#include "ray_scatter.h"
+#include "ray_light.h"
+#include "ray_intersect.h"
+#include "ray_material.h"
+#include "ray_path.h"
+#include "ray_wavefront.h"
+
+static void CastSampleRays(CastState* cast)
+{
+	World* world = cast->world;
+	u32 raysPerPixel = cast->raysPerPixel;
+	u32 maxBounceCount = cast->maxBounceCount;
+	u32 rouletteStartBounce = cast->rouletteStartBounce;
+	lane_f32 filmX = LaneF32FromF32(cast->filmX + cast->halfPixW);
+	lane_f32 filmY = LaneF32FromF32(cast->filmY + cast->halfPixH);
+	lane_v3 filmCenter = LaneV3FromV3(cast->filmCenter);
+	lane_f32 filmW = LaneF32FromF32(cast->filmW);
+	lane_f32 filmH = LaneF32FromF32(cast->filmH);
+	lane_f32 halfPixW = LaneF32FromF32(cast->halfPixW);
+	lane_f32 halfPixH = LaneF32FromF32(cast->halfPixH);
+	lane_v3 cameraX = LaneV3FromV3(cast->cameraX);
+	lane_v3 cameraY = LaneV3FromV3(cast->cameraY);
+	lane_v3 cameraPos = LaneV3FromV3(cast->cameraPos);
+
+	lane_u32 bounces = LaneU32FromU32(0);
+	u64 laneSlots = 0;
+	// NOTE: summed one sample at a time in sample order, like the scalar and wavefront kernels do, so the
+	// pixel rounds the same at every lane width
+	vec3 color = {};
+
+	u32 laneRayCount = raysPerPixel / LANE_WIDTH;
+	assert(laneRayCount * LANE_WIDTH ==	raysPerPixel);
+
+	// NOTE: adaptive sampling stops once the standard error of the pixel's mean luminance is below
+	// threshold * (mean + ADAPTIVE_ERROR_FLOOR), checked after every lane batch past the minimum. The
+	// statistics go on from the pixel's earlier passes, so passes stop a pixel where one pass would
+	f32 adaptiveThreshold = cast->adaptiveThreshold;
+	u32 minRayCount = (cast->minRaysPerPixel > 2) ? cast->minRaysPerPixel : 2;
+	lane_v3 luminanceWeights = Vec3(0.2126f, 0.7152f, 0.0722f);
+	lane_f32 luminanceSum = LaneF32FromF32(0.0f);
+	lane_f32 luminanceSqSum = LaneF32FromF32(0.0f);
+	bool converged = false;
+
+	u32 rayIndex = 0;
+	while (rayIndex < laneRayCount)
+	{
+		Sampler sampler = StartSample(cast->samplerKind, cast->pixelIndex, cast->firstSampleIndex + rayIndex * LANE_WIDTH);
+
+		lane_f32 jitterX, jitterY;
+		Sample2D(&sampler, &jitterX, &jitterY);
+		lane_f32 offX = filmX + halfPixW * (2.0f * jitterX - 1.0f);
+		lane_f32 offY = filmY + halfPixH * (2.0f * jitterY - 1.0f);
+		lane_v3 filmPos = filmCenter + offX * 0.5f * filmW * cameraX + offY * 0.5f * filmH * cameraY;
+
+		PathLanes path = StartPath(sampler, cameraPos, VecNormalize(filmPos - cameraPos));
+		for (u32 bounce = 0; bounce < maxBounceCount; ++bounce)
+		{
+			lane_u32 laneIncrement = LaneU32FromU32(1);
+			bounces += (laneIncrement & path.laneMask);
+			laneSlots += LANE_WIDTH;
+
+			PathHit hit;
+			hit.dist = LaneF32FromF32(FLT_MAX);
+			hit.material = LaneU32FromU32(0);
+			hit.normal = Vec3(0.0f);
+			if (bounce == 0 && cast->packet)
+			{
+				IntersectCameraRays(world, cast->packet, path.rayOrigin, path.rayDir, path.laneMask, &hit.dist, &hit.material, &hit.normal);
+			}
+			else
+			{
+				IntersectWorld(world, path.rayOrigin, path.rayDir, path.laneMask, &hit.dist, &hit.material, &hit.normal);
+			}
+
+			AddHitEmission(world, &path, &hit);
+			if (MaskIsZero(path.laneMask)) // NOTE: all rays are dead
+			{
+				break;
+			}
+
+			ScatterPath(world, &path, &hit, bounce, maxBounceCount, rouletteStartBounce);
+		}
+
+		lane_v3 sample = path.sample;
+		for (u32 laneIndex = 0; laneIndex < LANE_WIDTH; ++laneIndex)
+		{
+			vec3 laneSample = ExtractLane(sample, laneIndex);
+			color.x += laneSample.x;
+			color.y += laneSample.y;
+			color.z += laneSample.z;
+		}
+		++rayIndex;
+
+		if (adaptiveThreshold > 0.0f)
+		{
+			lane_f32 luminance = Dot(sample, luminanceWeights);
+			luminanceSum += luminance;
+			luminanceSqSum += luminance * luminance;
+			u32 pixelRayCount = cast->priorRayCount + rayIndex * LANE_WIDTH;
+			if (pixelRayCount >= minRayCount)
+			{
+				f32 n = (f32)pixelRayCount;
+				f32 sum = cast->luminanceSum + HorizontalAdd(luminanceSum);
+				f32 mean = sum / n;
+				f32 variance = MaxF32((cast->luminanceSqSum + HorizontalAdd(luminanceSqSum) - sum * mean) / (n - 1.0f), 0.0f);
+				if (variance <= Square(adaptiveThreshold * (mean + ADAPTIVE_ERROR_FLOOR)) * n)
+				{
+					converged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	u32 rayCount = rayIndex * LANE_WIDTH;
+	cast->raysCast = rayCount;
+	cast->luminanceSum += HorizontalAdd(luminanceSum);
+	cast->luminanceSqSum += HorizontalAdd(luminanceSqSum);
+	cast->converged = converged;
+	cast->bouncesComputed += HorizontalAdd(bounces);
+	cast->laneSlotsComputed += laneSlots;
+	f32 invRayCount = 1.0f / (f32)rayCount;
+	cast->finalColor.x = color.x * invRayCount;
+	cast->finalColor.y = color.y * invRayCount;
+	cast->finalColor.z = color.z * invRayCount;
+}
+
+}
+
+void CAST_SAMPLE_RAYS(CastState* cast)
+{
+	LANE_NAMESPACE::CastSampleRays(cast);
+}
+
+void CAST_BLOCK_RAYS(CastState* cast)
+{
+	LANE_NAMESPACE::CastBlockRays(cast);
+}
+
+#endif
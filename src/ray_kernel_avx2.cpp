@@ -0,0 +1,6 @@
+#define LANE_WIDTH 8
+#define LANE_NAMESPACE Lane8
+#define CAST_SAMPLE_RAYS CastSampleRaysAVX2
+#define CAST_BLOCK_RAYS CastBlockRaysAVX2
+
+#include "ray_kernel.h"
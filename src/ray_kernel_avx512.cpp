@@ -0,0 +1,6 @@
+#define LANE_WIDTH 16
+#define LANE_NAMESPACE Lane16
+#define CAST_SAMPLE_RAYS CastSampleRaysAVX512
+#define CAST_BLOCK_RAYS CastBlockRaysAVX512
+
+#include "ray_kernel.h"
@@ -0,0 +1,6 @@
+#define LANE_WIDTH 1
+#define LANE_NAMESPACE Lane1
+#define CAST_SAMPLE_RAYS CastSampleRaysScalar
+#define CAST_BLOCK_RAYS CastBlockRaysScalar
+
+#include "ray_kernel.h"
@@ -0,0 +1,6 @@
+#define LANE_WIDTH 4
+#define LANE_NAMESPACE Lane4
+#define CAST_SAMPLE_RAYS CastSampleRaysSSE2
+#define CAST_BLOCK_RAYS CastBlockRaysSSE2
+
+#include "ray_kernel.h"
@@ -1,22 +1,56 @@
 #if !defined RAY_LANE
 # define RAY_LANE
 
-#if USE_SIMD
-# define LANE_WIDTH 4
-#else
-# define LANE_WIDTH 1
+// NOTE: LANE_WIDTH is set by the including translation unit, 8 needs AVX2 and 16 needs AVX-512F
+#if !defined LANE_WIDTH
+#error LANE_WIDTH must be defined before including ray_lane.h
 #endif
 
-struct vec3
+inline u32 CountSetBits(u32 a)
 {
-	float x, y, z;
-};
+	u32 result = 0;
+	while (a)
+	{
+		a &= a - 1;
+		++result;
+	}
+
+	return result;
+}
+
+///
+/// 16-wide AVX-512
+///
+#if (LANE_WIDTH==16)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+#include "ray_lane_16.h"
+
+///
+/// 8-wide AVX2
+///
+#elif (LANE_WIDTH==8)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+#include "ray_lane_8.h"
 
 ///
 /// 4-wide SIMD
 /// 
-#if (LANE_WIDTH==4)
+#elif (LANE_WIDTH==4)
+#if defined(_MSC_VER)
 #include <intrin.h>
+#else
+#include <emmintrin.h>
+#endif
 
 #include "ray_lane_4.h"
 
@@ -53,6 +87,14 @@ lane_v3 operator&(lane_u32 a, lane_v3 b)
 	return result;
 }
 
+// NOTE: scalar masks are 0 or 1, so ~a & b would keep everything but the low bit
+lane_u32 AndNot(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result = a ? 0 : b;
+
+	return result;
+}
+
 lane_u32 LaneU32FromU32(u32 a)
 {
 	lane_u32 result = a;
@@ -60,10 +102,33 @@ lane_u32 LaneU32FromU32(u32 a)
 	return result;
 }
 
-lane_u32 LaneU32FromU32(u32 a0, u32 a1, u32 a2, u32 a3)
+lane_u32 LoadLaneU32(u32* src)
 {
-	// TODO: Maybe should do something about this?
-	lane_u32 result = a0;
+	lane_u32 result = *src;
+
+	return result;
+}
+
+void StoreLaneU32(u32* dest, lane_u32 a)
+{
+	*dest = a;
+}
+
+void StoreLaneF32(f32* dest, lane_f32 a)
+{
+	*dest = a;
+}
+
+lane_f32 LoadLaneF32(f32* src)
+{
+	lane_f32 result = *src;
+
+	return result;
+}
+
+lane_u32 LaneIndices()
+{
+	lane_u32 result = 0;
 
 	return result;
 }
@@ -93,6 +158,12 @@ void ConditionalAssign(lane_f32* dest, lane_u32 mask, lane_f32 source)
 	ConditionalAssign((lane_u32*)dest, mask, *(lane_u32*)&source);
 }
 
+lane_f32 Min(lane_f32 a, lane_f32 b)
+{
+	lane_f32 result = a < b ? a : b;
+	return result;
+}
+
 lane_f32 Max(lane_f32 a, lane_f32 b)
 {
 	lane_f32 result = a > b ? a : b;
@@ -117,6 +188,34 @@ f32 HorizontalAdd(lane_f32 a)
 	return result;
 }
 
+f32 HorizontalMin(lane_f32 a)
+{
+	f32 result = a;
+	return result;
+}
+
+u32 MaskLaneCount(lane_u32 mask)
+{
+	u32 result = mask ? 1 : 0;
+	return result;
+}
+
+u32 MaskBits(lane_u32 mask)
+{
+	u32 result = mask ? 1 : 0;
+	return result;
+}
+
+lane_f32 PermuteLanes(lane_f32 a, lane_u32 indices)
+{
+	return a;
+}
+
+lane_u32 PermuteLanes(lane_u32 a, lane_u32 indices)
+{
+	return a;
+}
+
 lane_f32 GatherF32_(void* basePtr, u32 stride, lane_u32 index)
 {
 	lane_f32 result = (*(f32*)((u8*)basePtr + index * stride));
@@ -124,8 +223,29 @@ lane_f32 GatherF32_(void* basePtr, u32 stride, lane_u32 index)
 	return result;
 }
 
+lane_u32 GatherU32_(void* basePtr, u32 stride, lane_u32 index)
+{
+	lane_u32 result = (*(u32*)((u8*)basePtr + index * stride));
+
+	return result;
+}
+
+lane_f32 GatherPackedF32(f32* base, lane_u32 indices)
+{
+	lane_f32 result = base[indices];
+
+	return result;
+}
+
+lane_u32 GatherPackedU32(u32* base, lane_u32 indices)
+{
+	lane_u32 result = base[indices];
+
+	return result;
+}
+
 #else
-#error LANE_WIDTH should be 1 or 4
+#error LANE_WIDTH should be 1, 4, 8 or 16
 #endif
 
 #if LANE_WIDTH != 1
@@ -142,6 +262,48 @@ vec3 Extract0(lane_v3 a)
 	return result;
 }
 
+// NOTE: single lane access, lane types are plain arrays of LANE_WIDTH values in memory
+f32 ExtractLane(lane_f32 a, u32 laneIndex)
+{
+	f32 result = ((f32*)&a)[laneIndex];
+
+	return result;
+}
+
+u32 ExtractLane(lane_u32 a, u32 laneIndex)
+{
+	u32 result = ((u32*)&a)[laneIndex];
+
+	return result;
+}
+
+vec3 ExtractLane(lane_v3 a, u32 laneIndex)
+{
+	vec3 result;
+	result.x = ExtractLane(a.x, laneIndex);
+	result.y = ExtractLane(a.y, laneIndex);
+	result.z = ExtractLane(a.z, laneIndex);
+
+	return result;
+}
+
+void SetLane(lane_f32* dest, u32 laneIndex, f32 value)
+{
+	((f32*)dest)[laneIndex] = value;
+}
+
+void SetLane(lane_u32* dest, u32 laneIndex, u32 value)
+{
+	((u32*)dest)[laneIndex] = value;
+}
+
+void SetLane(lane_v3* dest, u32 laneIndex, vec3 value)
+{
+	SetLane(&dest->x, laneIndex, value.x);
+	SetLane(&dest->y, laneIndex, value.y);
+	SetLane(&dest->z, laneIndex, value.z);
+}
+
 void ConditionalAssign(lane_v3* dest, lane_u32 mask, lane_v3 source)
 {
 	ConditionalAssign(&dest->x, mask, source.x);
@@ -161,6 +323,34 @@ vec3 HorizontalAdd(lane_v3 a)
 	return result;
 }
 
+// NOTE: indices for PermuteLanes that move the lanes of mask to the front, in order
+lane_u32 CompressIndices(lane_u32 mask)
+{
+	u32 bits = MaskBits(mask);
+	u32 indices[LANE_WIDTH] = {};
+	u32 count = 0;
+	for (u32 laneIndex = 0; laneIndex < LANE_WIDTH; ++laneIndex)
+	{
+		if (bits & (1u << laneIndex))
+		{
+			indices[count++] = laneIndex;
+		}
+	}
+
+	lane_u32 result = LoadLaneU32(indices);
+	return result;
+}
+
+lane_v3 PermuteLanes(lane_v3 a, lane_u32 indices)
+{
+	lane_v3 result;
+	result.x = PermuteLanes(a.x, indices);
+	result.y = PermuteLanes(a.y, indices);
+	result.z = PermuteLanes(a.z, indices);
+
+	return result;
+}
+
 lane_v3 LaneV3FromV3(vec3 v)
 {
 	lane_v3 result;
@@ -182,6 +372,7 @@ lane_v3 GatherV3_(void* basePtr, u32 stride, lane_u32 indices)
 }
 
 #define GATHER_F32(basePtr, index, member) GatherF32_(&(basePtr)->member, sizeof(*(basePtr)), index)
+#define GATHER_U32(basePtr, index, member) GatherU32_(&(basePtr)->member, sizeof(*(basePtr)), index)
 #define GATHER_V3(basePtr, index, member) GatherV3_(&(basePtr)->member, sizeof(*(basePtr)), index)
 
 #endif
\ No newline at end of file
@@ -0,0 +1,572 @@
+#if !defined RAY_LANE_16
+# define RAY_LANE_16
+
+struct lane_f32
+{
+	__m512 v;
+	lane_f32& operator=(f32 a);
+};
+struct lane_u32
+{
+	__m512i v;
+	lane_u32& operator=(u32 a);
+};
+
+struct lane_v3
+{
+	lane_f32 x;
+	lane_f32 y;
+	lane_f32 z;
+};
+
+// NOTE: lane_u32 stays a full vector so it can carry indices too, masks convert to k registers where used
+__mmask16 MaskFromLane(lane_u32 a)
+{
+	__mmask16 result = _mm512_test_epi32_mask(a.v, a.v);
+
+	return result;
+}
+
+lane_u32 LaneFromMask(__mmask16 mask)
+{
+	lane_u32 result;
+	result.v = _mm512_maskz_set1_epi32(mask, 0xFFFFFFFF);
+
+	return result;
+}
+
+lane_u32 operator^(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm512_xor_si512(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 operator^=(lane_u32& a, lane_u32 b)
+{
+	a = a ^ b;
+
+	return a;
+}
+
+lane_u32 operator&(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm512_and_si512(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 operator&=(lane_u32& a, lane_u32 b)
+{
+	a = a & b;
+
+	return a;
+}
+
+lane_f32 operator&(lane_u32 a, lane_f32 b)
+{
+	lane_f32 result;
+	result.v = _mm512_maskz_mov_ps(MaskFromLane(a), b.v);
+
+	return result;
+}
+
+lane_v3 operator&(lane_u32 a, lane_v3 b)
+{
+	lane_v3 result;
+	result.x = a & b.x;
+	result.y = a & b.y;
+	result.z = a & b.z;
+
+	return result;
+}
+
+lane_u32 AndNot(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm512_andnot_si512(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 LaneU32FromU32(u32 a)
+{
+	lane_u32 result;
+	result.v = _mm512_set1_epi32(a);
+
+	return result;
+}
+
+lane_u32 LoadLaneU32(u32* src)
+{
+	lane_u32 result;
+	result.v = _mm512_loadu_si512(src);
+
+	return result;
+}
+
+void StoreLaneU32(u32* dest, lane_u32 a)
+{
+	_mm512_storeu_si512(dest, a.v);
+}
+
+void StoreLaneF32(f32* dest, lane_f32 a)
+{
+	_mm512_storeu_ps(dest, a.v);
+}
+
+lane_f32 LoadLaneF32(f32* src)
+{
+	lane_f32 result;
+	result.v = _mm512_loadu_ps(src);
+
+	return result;
+}
+
+lane_u32 LaneIndices()
+{
+	lane_u32 result;
+	result.v = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	return result;
+}
+
+lane_f32 LaneF32FromU32(lane_u32 a)
+{
+	lane_f32 result;
+	result.v = _mm512_cvtepi32_ps(a.v);
+
+	return result;
+}
+
+lane_f32 LaneF32FromU32(u32 a)
+{
+	lane_f32 result;
+	result.v = _mm512_set1_ps((f32)a);
+
+	return result;
+}
+
+lane_f32 LaneF32FromF32(f32 a)
+{
+	lane_f32 result;
+	result.v = _mm512_set1_ps(a);
+
+	return result;
+}
+
+lane_u32 operator|(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm512_or_si512(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 operator<<(lane_u32 a, u32 shift)
+{
+	lane_u32 result;
+	result.v = _mm512_slli_epi32(a.v, shift);
+
+	return result;
+}
+
+lane_u32 operator>>(lane_u32 a, u32 shift)
+{
+	lane_u32 result;
+	result.v = _mm512_srli_epi32(a.v, shift);
+
+	return result;
+}
+
+lane_u32 operator<(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result = LaneFromMask(_mm512_cmplt_epi32_mask(a.v, b.v));
+
+	return result;
+}
+
+lane_u32 operator<(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneFromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ));
+
+	return result;
+}
+
+lane_u32 operator<(lane_f32 a, f32 b)
+{
+	lane_u32 result = a < LaneF32FromF32(b);
+
+	return result;
+}
+
+lane_u32 operator<(f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneF32FromF32(a) < b;
+
+	return result;
+}
+
+lane_u32 operator<=(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneFromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ));
+
+	return result;
+}
+
+lane_u32 operator>(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneFromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ));
+
+	return result;
+}
+
+lane_u32 operator>(lane_f32 a, f32 b)
+{
+	lane_u32 result = a > LaneF32FromF32(b);
+
+	return result;
+}
+
+lane_u32 operator>(f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneF32FromF32(a) > b;
+
+	return result;
+}
+
+lane_u32 operator>=(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneFromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ));
+
+	return result;
+}
+
+lane_u32 operator==(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneFromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_EQ_OQ));
+
+	return result;
+}
+
+lane_u32 operator!=(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneFromMask(_mm512_cmp_ps_mask(a.v, b.v, _CMP_NEQ_UQ));
+
+	return result;
+}
+
+lane_u32 operator!=(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result = LaneFromMask(_mm512_cmpneq_epi32_mask(a.v, b.v));
+
+	return result;
+}
+
+lane_u32& lane_u32::operator=(u32 b)
+{
+	*this = LaneU32FromU32(b);
+
+	return *this;
+}
+
+lane_f32& lane_f32::operator=(f32 b)
+{
+	*this = LaneF32FromF32(b);
+
+	return *this;
+}
+
+lane_f32 operator+(lane_f32 a, lane_f32 b)
+{
+	lane_f32 result;
+	result.v = _mm512_add_ps(a.v, b.v);
+
+	return result;
+}
+
+lane_f32 operator+(lane_f32 a, f32 b)
+{
+	lane_f32 result = a + LaneF32FromF32(b);
+
+	return result;
+}
+
+lane_f32 operator+(f32 a, lane_f32 b)
+{
+	lane_f32 result = LaneF32FromF32(a) + b;
+
+	return result;
+}
+
+lane_f32 operator+=(lane_f32& a, lane_f32 b)
+{
+	a = a + b;
+
+	return a;
+}
+
+lane_u32 operator+(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm512_add_epi32(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 operator+=(lane_u32& a, lane_u32 b)
+{
+	a = a + b;
+
+	return a;
+}
+
+lane_u32 operator*(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm512_mullo_epi32(a.v, b.v);
+
+	return result;
+}
+
+lane_f32 operator-(lane_f32 a, lane_f32 div)
+{
+	lane_f32 result;
+	result.v = _mm512_sub_ps(a.v, div.v);
+
+	return result;
+}
+
+lane_f32 operator-(lane_f32 a, f32 div)
+{
+	lane_f32 result = a - LaneF32FromF32(div);
+
+	return result;
+}
+
+lane_f32 operator-(f32 a, lane_f32 div)
+{
+	lane_f32 result = LaneF32FromF32(a) - div;
+
+	return result;
+}
+
+lane_f32 operator-(lane_f32 a)
+{
+	lane_f32 result = LaneF32FromF32(0) - a;
+
+	return result;
+}
+
+lane_f32 operator*(lane_f32 a, lane_f32 div)
+{
+	lane_f32 result;
+	result.v = _mm512_mul_ps(a.v, div.v);
+
+	return result;
+}
+
+lane_f32 operator*(lane_f32 a, f32 div)
+{
+	lane_f32 result = a * LaneF32FromF32(div);
+
+	return result;
+}
+
+lane_f32 operator*(f32 a, lane_f32 div)
+{
+	lane_f32 result = LaneF32FromF32(a) * div;
+
+	return result;
+}
+
+lane_v3 operator*(lane_v3 a, lane_f32 b)
+{
+	lane_v3 result;
+	result.x = a.x * b;
+	result.y = a.y * b;
+	result.z = a.z * b;
+
+	return result;
+}
+
+lane_v3 operator*(lane_f32 a, lane_v3 b)
+{
+	lane_v3 result = b * a;
+
+	return result;
+}
+
+lane_f32 operator/(lane_f32 a, lane_f32 div)
+{
+	lane_f32 result;
+	result.v = _mm512_div_ps(a.v, div.v);
+
+	return result;
+}
+
+lane_f32 operator/(lane_f32 a, f32 div)
+{
+	lane_f32 result = a / LaneF32FromF32(div);
+
+	return result;
+}
+
+lane_f32 operator/(f32 a, lane_f32 div)
+{
+	lane_f32 result = LaneF32FromF32(a) / div;
+
+	return result;
+}
+
+lane_v3 operator+(lane_v3 a, lane_v3 b)
+{
+	lane_v3 result;
+	result.x = a.x + b.x;
+	result.y = a.y + b.y;
+	result.z = a.z + b.z;
+
+	return result;
+}
+
+lane_f32 SquareRoot(lane_f32 a)
+{
+	lane_f32 result;
+	// may use here the rsqrts instead (more speed but less accurate)
+	result.v = _mm512_sqrt_ps(a.v);
+
+	return result;
+}
+
+void ConditionalAssign(lane_f32* dest, lane_u32 mask, lane_f32 source)
+{
+	dest->v = _mm512_mask_blend_ps(MaskFromLane(mask), dest->v, source.v);
+}
+
+void ConditionalAssign(lane_u32* dest, lane_u32 mask, lane_u32 source)
+{
+	dest->v = _mm512_mask_blend_epi32(MaskFromLane(mask), dest->v, source.v);
+}
+
+lane_f32 Min(lane_f32 a, lane_f32 b)
+{
+	lane_f32 result;
+	result.v = _mm512_min_ps(a.v, b.v);
+
+	return result;
+}
+
+lane_f32 Max(lane_f32 a, lane_f32 b)
+{
+	lane_f32 result;
+	result.v = _mm512_max_ps(a.v, b.v);
+
+	return result;
+}
+
+lane_f32 Clamp01(lane_f32 value)
+{
+	lane_f32 result = Min(Max(value, LaneF32FromF32(0.0f)), LaneF32FromF32(1.0f));
+
+	return result;
+}
+
+lane_f32 GatherF32_(void* basePtr, u32 stride, lane_u32 indices)
+{
+	// NOTE: the gather scale must be an immediate, so the stride is folded into byte offsets
+	__m512i offsets = _mm512_mullo_epi32(indices.v, _mm512_set1_epi32(stride));
+	lane_f32 result;
+	result.v = _mm512_i32gather_ps(offsets, basePtr, 1);
+
+	return result;
+}
+
+lane_u32 GatherU32_(void* basePtr, u32 stride, lane_u32 indices)
+{
+	__m512i offsets = _mm512_mullo_epi32(indices.v, _mm512_set1_epi32(stride));
+	lane_u32 result;
+	result.v = _mm512_i32gather_epi32(offsets, basePtr, 1);
+
+	return result;
+}
+
+// NOTE: a lane per index into a packed array, 4 byte entries fit the gather's scale without a multiply
+lane_f32 GatherPackedF32(f32* base, lane_u32 indices)
+{
+	lane_f32 result;
+	result.v = _mm512_i32gather_ps(indices.v, base, 4);
+
+	return result;
+}
+
+lane_u32 GatherPackedU32(u32* base, lane_u32 indices)
+{
+	lane_u32 result;
+	result.v = _mm512_i32gather_epi32(indices.v, base, 4);
+
+	return result;
+}
+
+bool MaskIsZero(lane_u32 mask)
+{
+	bool result = (MaskFromLane(mask) == 0);
+
+	return result;
+}
+
+u32 MaskLaneCount(lane_u32 mask)
+{
+	u32 result = CountSetBits(MaskFromLane(mask));
+
+	return result;
+}
+
+u32 MaskBits(lane_u32 mask)
+{
+	u32 result = MaskFromLane(mask);
+
+	return result;
+}
+
+lane_f32 PermuteLanes(lane_f32 a, lane_u32 indices)
+{
+	lane_f32 result;
+	result.v = _mm512_permutexvar_ps(indices.v, a.v);
+
+	return result;
+}
+
+lane_u32 PermuteLanes(lane_u32 a, lane_u32 indices)
+{
+	lane_u32 result;
+	result.v = _mm512_permutexvar_epi32(indices.v, a.v);
+
+	return result;
+}
+
+u64 HorizontalAdd(lane_u32 a)
+{
+	__m512i lo = _mm512_cvtepu32_epi64(_mm512_castsi512_si256(a.v));
+	__m512i hi = _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(a.v, 1));
+	u64 result = (u64)_mm512_reduce_add_epi64(_mm512_add_epi64(lo, hi));
+
+	return result;
+}
+
+f32 HorizontalAdd(lane_f32 a)
+{
+	f32 result = _mm512_reduce_add_ps(a.v);
+
+	return result;
+}
+
+f32 HorizontalMin(lane_f32 a)
+{
+	f32 result = _mm512_reduce_min_ps(a.v);
+
+	return result;
+}
+
+#endif
\ No newline at end of file
@@ -83,10 +83,36 @@ lane_u32 LaneU32FromU32(u32 a)
 	return result;
 }
 
-lane_u32 LaneU32FromU32(u32 a0, u32 a1, u32 a2, u32 a3)
+lane_u32 LoadLaneU32(u32* src)
 {
 	lane_u32 result;
-	result.v = _mm_setr_epi32(a0, a1, a2, a3);
+	result.v = _mm_loadu_si128((__m128i*)src);
+
+	return result;
+}
+
+void StoreLaneU32(u32* dest, lane_u32 a)
+{
+	_mm_storeu_si128((__m128i*)dest, a.v);
+}
+
+void StoreLaneF32(f32* dest, lane_f32 a)
+{
+	_mm_storeu_ps(dest, a.v);
+}
+
+lane_f32 LoadLaneF32(f32* src)
+{
+	lane_f32 result;
+	result.v = _mm_loadu_ps(src);
+
+	return result;
+}
+
+lane_u32 LaneIndices()
+{
+	lane_u32 result;
+	result.v = _mm_setr_epi32(0, 1, 2, 3);
 
 	return result;
 }
@@ -139,6 +165,14 @@ lane_u32 operator>>(lane_u32 a, u32 shift)
 	return result;
 }
 
+lane_u32 operator<(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm_cmplt_epi32(a.v, b.v);
+
+	return result;
+}
+
 lane_u32 operator<(lane_f32 a, lane_f32 b)
 {
 	lane_u32 result;
@@ -281,6 +315,18 @@ lane_u32 operator+=(lane_u32& a, lane_u32 b)
 	return a;
 }
 
+lane_u32 operator*(lane_u32 a, lane_u32 b)
+{
+	// NOTE: SSE2 has no 32-bit low multiply, even and odd lanes go through _mm_mul_epu32 and get interleaved back
+	__m128i even = _mm_mul_epu32(a.v, b.v);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.v, 32), _mm_srli_epi64(b.v, 32));
+
+	lane_u32 result;
+	result.v = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+
+	return result;
+}
+
 lane_f32 operator-(lane_f32 a, lane_f32 div)
 {
 	lane_f32 result;
@@ -436,6 +482,37 @@ lane_f32 GatherF32_(void* basePtr, u32 stride, lane_u32 indices)
 	return result;
 }
 
+lane_u32 GatherU32_(void* basePtr, u32 stride, lane_u32 indices)
+{
+	u32* v = (u32*)&indices.v;
+	lane_u32 result;
+	result.v = _mm_setr_epi32(*(i32*)((u8*)basePtr + v[0] * stride),
+		*(i32*)((u8*)basePtr + v[1] * stride),
+		*(i32*)((u8*)basePtr + v[2] * stride),
+		*(i32*)((u8*)basePtr + v[3] * stride));
+
+	return result;
+}
+
+// NOTE: a lane per index into a packed array. SSE2 has no gather, the lanes are loaded one by one
+lane_f32 GatherPackedF32(f32* base, lane_u32 indices)
+{
+	u32* v = (u32*)&indices.v;
+	lane_f32 result;
+	result.v = _mm_setr_ps(base[v[0]], base[v[1]], base[v[2]], base[v[3]]);
+
+	return result;
+}
+
+lane_u32 GatherPackedU32(u32* base, lane_u32 indices)
+{
+	u32* v = (u32*)&indices.v;
+	lane_u32 result;
+	result.v = _mm_setr_epi32((i32)base[v[0]], (i32)base[v[1]], (i32)base[v[2]], (i32)base[v[3]]);
+
+	return result;
+}
+
 bool MaskIsZero(lane_u32 mask)
 {
 	int result = _mm_movemask_epi8(mask.v);
@@ -443,6 +520,41 @@ bool MaskIsZero(lane_u32 mask)
 	return (result == 0);
 }
 
+u32 MaskLaneCount(lane_u32 mask)
+{
+	u32 result = CountSetBits((u32)_mm_movemask_ps(_mm_castsi128_ps(mask.v)));
+
+	return result;
+}
+
+u32 MaskBits(lane_u32 mask)
+{
+	u32 result = (u32)_mm_movemask_ps(_mm_castsi128_ps(mask.v));
+
+	return result;
+}
+
+// NOTE: SSE2 has no variable shuffle, the lanes go through memory
+lane_f32 PermuteLanes(lane_f32 a, lane_u32 indices)
+{
+	f32* values = (f32*)&a;
+	u32* index = (u32*)&indices;
+	lane_f32 result;
+	result.v = _mm_setr_ps(values[index[0]], values[index[1]], values[index[2]], values[index[3]]);
+
+	return result;
+}
+
+lane_u32 PermuteLanes(lane_u32 a, lane_u32 indices)
+{
+	u32* values = (u32*)&a;
+	u32* index = (u32*)&indices;
+	lane_u32 result;
+	result.v = _mm_setr_epi32(values[index[0]], values[index[1]], values[index[2]], values[index[3]]);
+
+	return result;
+}
+
 u64 HorizontalAdd(lane_u32 a)
 {
 	u32* v = (u32*)&(a.v);
@@ -459,4 +571,13 @@ f32 HorizontalAdd(lane_f32 a)
 	return result;
 }
 
+f32 HorizontalMin(lane_f32 a)
+{
+	__m128 min2 = _mm_min_ps(a.v, _mm_movehl_ps(a.v, a.v));
+	__m128 min1 = _mm_min_ss(min2, _mm_shuffle_ps(min2, min2, 1));
+	f32 result = _mm_cvtss_f32(min1);
+
+	return result;
+}
+
 #endif
\ No newline at end of file
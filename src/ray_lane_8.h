@@ -0,0 +1,574 @@
+#if !defined RAY_LANE_8
+# define RAY_LANE_8
+
+struct lane_f32
+{
+	__m256 v;
+	lane_f32& operator=(f32 a);
+};
+struct lane_u32
+{
+	__m256i v;
+	lane_u32& operator=(u32 a);
+};
+
+struct lane_v3
+{
+	lane_f32 x;
+	lane_f32 y;
+	lane_f32 z;
+};
+
+lane_u32 operator^(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_xor_si256(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 operator^=(lane_u32& a, lane_u32 b)
+{
+	a = a ^ b;
+
+	return a;
+}
+
+lane_u32 operator&(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_and_si256(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 operator&=(lane_u32& a, lane_u32 b)
+{
+	a = a & b;
+
+	return a;
+}
+
+lane_f32 operator&(lane_u32 a, lane_f32 b)
+{
+	lane_f32 result;
+	result.v = _mm256_and_ps(_mm256_castsi256_ps(a.v), b.v);
+
+	return result;
+}
+
+lane_v3 operator&(lane_u32 a, lane_v3 b)
+{
+	lane_v3 result;
+	result.x = a & b.x;
+	result.y = a & b.y;
+	result.z = a & b.z;
+
+	return result;
+}
+
+lane_u32 AndNot(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_andnot_si256(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 LaneU32FromU32(u32 a)
+{
+	lane_u32 result;
+	result.v = _mm256_set1_epi32(a);
+
+	return result;
+}
+
+lane_u32 LoadLaneU32(u32* src)
+{
+	lane_u32 result;
+	result.v = _mm256_loadu_si256((__m256i*)src);
+
+	return result;
+}
+
+void StoreLaneU32(u32* dest, lane_u32 a)
+{
+	_mm256_storeu_si256((__m256i*)dest, a.v);
+}
+
+void StoreLaneF32(f32* dest, lane_f32 a)
+{
+	_mm256_storeu_ps(dest, a.v);
+}
+
+lane_f32 LoadLaneF32(f32* src)
+{
+	lane_f32 result;
+	result.v = _mm256_loadu_ps(src);
+
+	return result;
+}
+
+lane_u32 LaneIndices()
+{
+	lane_u32 result;
+	result.v = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	return result;
+}
+
+lane_f32 LaneF32FromU32(lane_u32 a)
+{
+	lane_f32 result;
+	result.v = _mm256_cvtepi32_ps(a.v);
+
+	return result;
+}
+
+lane_f32 LaneF32FromU32(u32 a)
+{
+	lane_f32 result;
+	result.v = _mm256_set1_ps((f32)a);
+
+	return result;
+}
+
+lane_f32 LaneF32FromF32(f32 a)
+{
+	lane_f32 result;
+	result.v = _mm256_set1_ps(a);
+
+	return result;
+}
+
+lane_u32 operator|(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_or_si256(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 operator<<(lane_u32 a, u32 shift)
+{
+	lane_u32 result;
+	result.v = _mm256_slli_epi32(a.v, shift);
+
+	return result;
+}
+
+lane_u32 operator>>(lane_u32 a, u32 shift)
+{
+	lane_u32 result;
+	result.v = _mm256_srli_epi32(a.v, shift);
+
+	return result;
+}
+
+lane_u32 operator<(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_cmpgt_epi32(b.v, a.v);
+
+	return result;
+}
+
+lane_u32 operator<(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ));
+
+	return result;
+}
+
+lane_u32 operator<(lane_f32 a, f32 b)
+{
+	lane_u32 result = a < LaneF32FromF32(b);
+
+	return result;
+}
+
+lane_u32 operator<(f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneF32FromF32(a) < b;
+
+	return result;
+}
+
+lane_u32 operator<=(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ));
+
+	return result;
+}
+
+lane_u32 operator>(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ));
+
+	return result;
+}
+
+lane_u32 operator>(lane_f32 a, f32 b)
+{
+	lane_u32 result = a > LaneF32FromF32(b);
+
+	return result;
+}
+
+lane_u32 operator>(f32 a, lane_f32 b)
+{
+	lane_u32 result = LaneF32FromF32(a) > b;
+
+	return result;
+}
+
+lane_u32 operator>=(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ));
+
+	return result;
+}
+
+lane_u32 operator==(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ));
+
+	return result;
+}
+
+lane_u32 operator!=(lane_f32 a, lane_f32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_castps_si256(_mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ));
+
+	return result;
+}
+
+lane_u32 operator!=(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_xor_si256(_mm256_cmpeq_epi32(a.v, b.v), _mm256_set1_epi32(0xFFFFFFFF));
+
+	return result;
+}
+
+lane_u32& lane_u32::operator=(u32 b)
+{
+	*this = LaneU32FromU32(b);
+
+	return *this;
+}
+
+lane_f32& lane_f32::operator=(f32 b)
+{
+	*this = LaneF32FromF32(b);
+
+	return *this;
+}
+
+lane_f32 operator+(lane_f32 a, lane_f32 b)
+{
+	lane_f32 result;
+	result.v = _mm256_add_ps(a.v, b.v);
+
+	return result;
+}
+
+lane_f32 operator+(lane_f32 a, f32 b)
+{
+	lane_f32 result = a + LaneF32FromF32(b);
+
+	return result;
+}
+
+lane_f32 operator+(f32 a, lane_f32 b)
+{
+	lane_f32 result = LaneF32FromF32(a) + b;
+
+	return result;
+}
+
+lane_f32 operator+=(lane_f32& a, lane_f32 b)
+{
+	a = a + b;
+
+	return a;
+}
+
+lane_u32 operator+(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_add_epi32(a.v, b.v);
+
+	return result;
+}
+
+lane_u32 operator+=(lane_u32& a, lane_u32 b)
+{
+	a = a + b;
+
+	return a;
+}
+
+lane_u32 operator*(lane_u32 a, lane_u32 b)
+{
+	lane_u32 result;
+	result.v = _mm256_mullo_epi32(a.v, b.v);
+
+	return result;
+}
+
+lane_f32 operator-(lane_f32 a, lane_f32 div)
+{
+	lane_f32 result;
+	result.v = _mm256_sub_ps(a.v, div.v);
+
+	return result;
+}
+
+lane_f32 operator-(lane_f32 a, f32 div)
+{
+	lane_f32 result = a - LaneF32FromF32(div);
+
+	return result;
+}
+
+lane_f32 operator-(f32 a, lane_f32 div)
+{
+	lane_f32 result = LaneF32FromF32(a) - div;
+
+	return result;
+}
+
+lane_f32 operator-(lane_f32 a)
+{
+	lane_f32 result = LaneF32FromF32(0) - a;
+
+	return result;
+}
+
+lane_f32 operator*(lane_f32 a, lane_f32 div)
+{
+	lane_f32 result;
+	result.v = _mm256_mul_ps(a.v, div.v);
+
+	return result;
+}
+
+lane_f32 operator*(lane_f32 a, f32 div)
+{
+	lane_f32 result = a * LaneF32FromF32(div);
+
+	return result;
+}
+
+lane_f32 operator*(f32 a, lane_f32 div)
+{
+	lane_f32 result = LaneF32FromF32(a) * div;
+
+	return result;
+}
+
+lane_v3 operator*(lane_v3 a, lane_f32 b)
+{
+	lane_v3 result;
+	result.x = a.x * b;
+	result.y = a.y * b;
+	result.z = a.z * b;
+
+	return result;
+}
+
+lane_v3 operator*(lane_f32 a, lane_v3 b)
+{
+	lane_v3 result = b * a;
+
+	return result;
+}
+
+lane_f32 operator/(lane_f32 a, lane_f32 div)
+{
+	lane_f32 result;
+	result.v = _mm256_div_ps(a.v, div.v);
+
+	return result;
+}
+
+lane_f32 operator/(lane_f32 a, f32 div)
+{
+	lane_f32 result = a / LaneF32FromF32(div);
+
+	return result;
+}
+
+lane_f32 operator/(f32 a, lane_f32 div)
+{
+	lane_f32 result = LaneF32FromF32(a) / div;
+
+	return result;
+}
+
+lane_v3 operator+(lane_v3 a, lane_v3 b)
+{
+	lane_v3 result;
+	result.x = a.x + b.x;
+	result.y = a.y + b.y;
+	result.z = a.z + b.z;
+
+	return result;
+}
+
+lane_f32 SquareRoot(lane_f32 a)
+{
+	lane_f32 result;
+	// may use here the rsqrts instead (more speed but less accurate)
+	result.v = _mm256_sqrt_ps(a.v);
+
+	return result;
+}
+
+void ConditionalAssign(lane_f32* dest, lane_u32 mask, lane_f32 source)
+{
+	__m256 maskPS = _mm256_castsi256_ps(mask.v);
+	dest->v = _mm256_or_ps(_mm256_andnot_ps(maskPS, dest->v), _mm256_and_ps(maskPS, source.v));
+}
+
+void ConditionalAssign(lane_u32* dest, lane_u32 mask, lane_u32 source)
+{
+	*dest = AndNot(mask, *dest) | (mask & source);
+}
+
+lane_f32 Min(lane_f32 a, lane_f32 b)
+{
+	lane_f32 result;
+	result.v = _mm256_min_ps(a.v, b.v);
+
+	return result;
+}
+
+lane_f32 Max(lane_f32 a, lane_f32 b)
+{
+	lane_f32 result;
+	result.v = _mm256_max_ps(a.v, b.v);
+
+	return result;
+}
+
+lane_f32 Clamp01(lane_f32 value)
+{
+	lane_f32 result = Min(Max(value, LaneF32FromF32(0.0f)), LaneF32FromF32(1.0f));
+
+	return result;
+}
+
+lane_f32 GatherF32_(void* basePtr, u32 stride, lane_u32 indices)
+{
+	// NOTE: the gather scale must be an immediate, so the stride is folded into byte offsets
+	__m256i offsets = _mm256_mullo_epi32(indices.v, _mm256_set1_epi32(stride));
+	lane_f32 result;
+	result.v = _mm256_i32gather_ps((f32*)basePtr, offsets, 1);
+
+	return result;
+}
+
+lane_u32 GatherU32_(void* basePtr, u32 stride, lane_u32 indices)
+{
+	__m256i offsets = _mm256_mullo_epi32(indices.v, _mm256_set1_epi32(stride));
+	lane_u32 result;
+	result.v = _mm256_i32gather_epi32((int*)basePtr, offsets, 1);
+
+	return result;
+}
+
+// NOTE: a lane per index into a packed array, 4 byte entries fit the gather's scale without a multiply
+lane_f32 GatherPackedF32(f32* base, lane_u32 indices)
+{
+	lane_f32 result;
+	result.v = _mm256_i32gather_ps(base, indices.v, 4);
+
+	return result;
+}
+
+lane_u32 GatherPackedU32(u32* base, lane_u32 indices)
+{
+	lane_u32 result;
+	result.v = _mm256_i32gather_epi32((int*)base, indices.v, 4);
+
+	return result;
+}
+
+bool MaskIsZero(lane_u32 mask)
+{
+	int result = _mm256_movemask_epi8(mask.v);
+
+	return (result == 0);
+}
+
+u32 MaskLaneCount(lane_u32 mask)
+{
+	u32 result = CountSetBits((u32)_mm256_movemask_ps(_mm256_castsi256_ps(mask.v)));
+
+	return result;
+}
+
+u32 MaskBits(lane_u32 mask)
+{
+	u32 result = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(mask.v));
+
+	return result;
+}
+
+lane_f32 PermuteLanes(lane_f32 a, lane_u32 indices)
+{
+	lane_f32 result;
+	result.v = _mm256_permutevar8x32_ps(a.v, indices.v);
+
+	return result;
+}
+
+lane_u32 PermuteLanes(lane_u32 a, lane_u32 indices)
+{
+	lane_u32 result;
+	result.v = _mm256_permutevar8x32_epi32(a.v, indices.v);
+
+	return result;
+}
+
+u64 HorizontalAdd(lane_u32 a)
+{
+	u32* v = (u32*)&(a.v);
+	u64 result = 0;
+	for (u32 i = 0; i < 8; ++i)
+	{
+		result += v[i];
+	}
+
+	return result;
+}
+
+f32 HorizontalAdd(lane_f32 a)
+{
+	__m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+	__m128 sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+	__m128 sum1 = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 1));
+	f32 result = _mm_cvtss_f32(sum1);
+
+	return result;
+}
+
+f32 HorizontalMin(lane_f32 a)
+{
+	__m128 min4 = _mm_min_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+	__m128 min2 = _mm_min_ps(min4, _mm_movehl_ps(min4, min4));
+	__m128 min1 = _mm_min_ss(min2, _mm_shuffle_ps(min2, min2, 1));
+	f32 result = _mm_cvtss_f32(min1);
+
+	return result;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#if !defined RAY_LIGHT_H
+# define RAY_LIGHT_H
+
+//
+// Light sampling
+//
+// Next event estimation: at every bounce a light from World::lights is picked in proportion to its
+// power and a direction is drawn uniformly from the cone of directions its sphere covers. The same
+// light found by the bounce ray is weighted against this with the power heuristic, so direct light
+// comes from whichever of the two sampled it better (Veach 1997).
+//
+
+struct LightSample
+{
+	lane_v3 dir;
+	lane_f32 dist; // NOTE: to the near side of the light
+	lane_v3 emitColor;
+	lane_f32 pdf; // NOTE: solid angle, picking included
+	lane_u32 validMask; // NOTE: off where the point is inside the light
+};
+
+// NOTE: 1 - cos of the cone a sphere covers, written so small far lights don't cancel to 0
+static lane_f32 LightConeWidth(lane_f32 radiusSq, lane_f32 distSq)
+{
+	lane_f32 sinMaxSq = radiusSq / distSq;
+	lane_f32 cosMax = SquareRoot(Max(1.0f - sinMaxSq, LaneF32FromF32(0.0f)));
+	lane_f32 result = sinMaxSq / (1.0f + cosMax);
+
+	return result;
+}
+
+// NOTE: the last light with pickCDF at most u, a lane-wide binary search over the table
+static lane_u32 PickLight(World* world, lane_f32 u)
+{
+	u32 lightCount = world->lightCount;
+	u32 step = 1;
+	while (2 * step <= lightCount)
+	{
+		step *= 2;
+	}
+
+	lane_u32 result = LaneU32FromU32(0);
+	lane_u32 count = LaneU32FromU32(lightCount);
+	for (; step > 0; step >>= 1)
+	{
+		lane_u32 probe = result + LaneU32FromU32(step);
+		lane_u32 inRange = probe < count;
+		lane_u32 clampedProbe = LaneU32FromU32(0);
+		ConditionalAssign(&clampedProbe, inRange, probe);
+		lane_f32 probeCDF = GATHER_F32(world->lights, clampedProbe, pickCDF);
+		ConditionalAssign(&result, inRange & (probeCDF <= u), probe);
+	}
+
+	return result;
+}
+
+static LightSample SampleLight(World* world, lane_f32 pick, lane_f32 u, lane_f32 v, lane_v3 point)
+{
+	lane_u32 lightIndex = PickLight(world, pick);
+	lane_v3 lightPos = GATHER_V3(world->lights, lightIndex, pos);
+	lane_f32 radius = GATHER_F32(world->lights, lightIndex, radius);
+	lane_f32 pickProbability = GATHER_F32(world->lights, lightIndex, pickProbability);
+
+	lane_v3 toLight = lightPos - point;
+	lane_f32 distSq = Dot(toLight, toLight);
+	lane_f32 radiusSq = radius * radius;
+	lane_f32 coneWidth = LightConeWidth(radiusSq, distSq);
+
+	// NOTE: uniform in the cone, 1 - cos is uniform in [0, coneWidth]
+	lane_f32 oneMinusCos = u * coneWidth;
+	lane_f32 cosTheta = 1.0f - oneMinusCos;
+	lane_f32 sinTheta = SquareRoot(Max(oneMinusCos * (2.0f - oneMinusCos), LaneF32FromF32(0.0f)));
+	lane_f32 sinPhi, cosPhi;
+	SinCosTurns(v, &sinPhi, &cosPhi);
+
+	lane_v3 axis = (1.0f / SquareRoot(distSq)) * toLight;
+	lane_v3 tangent, bitangent;
+	OrthonormalBasis(axis, &tangent, &bitangent);
+
+	LightSample result;
+	result.dir = (sinTheta * cosPhi) * tangent + (sinTheta * sinPhi) * bitangent + cosTheta * axis;
+	lane_f32 along = Dot(result.dir, toLight);
+	result.dist = along - SquareRoot(Max(radiusSq - (distSq - along * along), LaneF32FromF32(0.0f)));
+	result.emitColor = GATHER_V3(world->lights, lightIndex, emitColor);
+	result.pdf = pickProbability / (2.0f * 3.14159265f * coneWidth);
+	result.validMask = (distSq > radiusSq);
+
+	return result;
+}
+
+// NOTE: the density SampleLight gives the direction from point that found the light
+static lane_f32 LightPdf(World* world, lane_u32 lightIndex, lane_v3 point)
+{
+	lane_v3 toLight = GATHER_V3(world->lights, lightIndex, pos) - point;
+	lane_f32 radius = GATHER_F32(world->lights, lightIndex, radius);
+	lane_f32 pickProbability = GATHER_F32(world->lights, lightIndex, pickProbability);
+
+	lane_f32 result = pickProbability / (2.0f * 3.14159265f * LightConeWidth(radius * radius, Dot(toLight, toLight)));
+	return result;
+}
+
+static lane_f32 PowerHeuristic(lane_f32 pdf, lane_f32 otherPdf)
+{
+	lane_f32 result = (pdf * pdf) / (pdf * pdf + otherPdf * otherPdf);
+	return result;
+}
+
+#endif
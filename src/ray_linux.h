@@ -0,0 +1,205 @@
+#if !defined RAY_LINUX
+# define RAY_LINUX
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+
+typedef pthread_t ThreadHandle;
+
+static bool RenderTile(WorkQueue* queue, u32 threadIndex);
+
+static void* ThreadProc(void* lpParameter)
+{
+	WorkThread* thread = (WorkThread*)lpParameter;
+	while (RenderTile(thread->queue, thread->threadIndex)) {};
+	return 0;
+}
+
+static bool CreateThread(ThreadHandle* thread, void* parametr)
+{
+	bool result = (pthread_create(thread, NULL, ThreadProc, parametr) == 0);
+	if (!result)
+	{
+		fprintf(stderr, "[ERROR] Unable to create worker thread.\n");
+	}
+
+	return result;
+}
+
+static void JoinThread(ThreadHandle thread)
+{
+	pthread_join(thread, NULL);
+}
+
+static u32 GetCpuCoreCount()
+{
+	u32 result = 0;
+
+	// NOTE: respect taskset / cgroup cpusets instead of counting every core on the host
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		result = CPU_COUNT(&set);
+	}
+	if (result == 0)
+	{
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		result = online > 0 ? (u32)online : 1;
+	}
+
+	return result;
+}
+
+static void* AllocateAligned(size_t size, size_t alignment)
+{
+	void* result = 0;
+	if (posix_memalign(&result, alignment, size) != 0)
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
+static void FreeAligned(void* memory)
+{
+	free(memory);
+}
+
+// NOTE: read only and shared, every process mapping the same file shares its page cache copy
+static MappedFile MapEntireFile(const char* fileName)
+{
+	MappedFile result = {};
+
+	int fd = open(fileName, O_RDONLY);
+	if (fd >= 0)
+	{
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			void* contents = mmap(0, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (contents != MAP_FAILED)
+			{
+				result.size = (size_t)info.st_size;
+				result.contents = contents;
+			}
+		}
+		close(fd);
+	}
+
+	return result;
+}
+
+static void UnmapEntireFile(MappedFile* file)
+{
+	munmap(file->contents, file->size);
+	*file = {};
+}
+
+// NOTE: ftell's long is only 32 bits on some targets, off_t is 64 bits on every 64-bit one
+static i64 GetFilePosition(FILE* file)
+{
+	i64 result = (i64)ftello(file);
+
+	return result;
+}
+
+static u64 LockedAdd(u64 volatile* value, u64 a)
+{
+	u64 result = __atomic_fetch_add(value, a, __ATOMIC_SEQ_CST);
+
+	return result;
+}
+
+static u32 AtomicCompareExchange(u32 volatile* value, u32 newValue, u32 expected)
+{
+	u32 result = expected;
+	__atomic_compare_exchange_n(value, &result, newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+	return result;
+}
+
+// NOTE: sleeps while *value == expected, returns on a wake, a spurious wakeup or the timeout
+static void WaitOnValue(u32 volatile* value, u32 expected, u32 timeoutMs)
+{
+	struct timespec timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_nsec = (long)(timeoutMs % 1000) * 1000000;
+	syscall(SYS_futex, (u32*)value, FUTEX_WAIT_PRIVATE, expected, &timeout, NULL, 0);
+}
+
+static void WakeAllWaiters(u32 volatile* value)
+{
+	syscall(SYS_futex, (u32*)value, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+}
+
+// NOTE: monotonic wall clock, unlike clock() it doesn't add up the time of every thread
+static f64 GetWallClockSeconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	f64 result = (f64)now.tv_sec + 1e-9 * (f64)now.tv_nsec;
+
+	return result;
+}
+
+static void YieldThread()
+{
+	sched_yield();
+}
+
+static void CpuRelax()
+{
+	__builtin_ia32_pause();
+}
+
+// NOTE: atomic on the same file system, readers see either the old file or the new one
+// NOTE: through the C library's buffer and the page cache, so the contents survive a crash of the host
+static bool SyncFile(FILE* file)
+{
+	bool result = (fflush(file) == 0 && fsync(fileno(file)) == 0);
+
+	return result;
+}
+
+// NOTE: the rename is only durable once the directory holding it is synced too. Filesystems that can't
+// sync a directory say EINVAL, there the rename is as durable as it gets
+static bool ReplaceFileWith(const char* fileName, const char* newFileName)
+{
+	bool result = (rename(newFileName, fileName) == 0);
+
+	if (result)
+	{
+		char directoryName[4096];
+		const char* slash = strrchr(fileName, '/');
+		if (slash)
+		{
+			snprintf(directoryName, sizeof(directoryName), "%.*s", (int)(slash - fileName + 1), fileName);
+		}
+		else
+		{
+			snprintf(directoryName, sizeof(directoryName), ".");
+		}
+
+		int fd = open(directoryName, O_RDONLY | O_DIRECTORY);
+		result = (fd >= 0);
+		if (result)
+		{
+			result = (fsync(fd) == 0 || errno == EINVAL);
+			close(fd);
+		}
+	}
+
+	return result;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#if !defined RAY_MATERIAL_H
+# define RAY_MATERIAL_H
+
+//
+// Material lookups
+//
+// A lane batch reads the materials its rays hit out of World::materialSoA, a gather per component.
+// Neighbouring rays mostly hit the same surface, and in the wavefront kernel the rays are grouped by
+// surface, so when every live lane hit one material each component is a single load broadcast to all
+// the lanes instead.
+//
+
+struct MaterialLookup
+{
+	lane_u32 indices;
+	bool uniform;
+	u32 uniformIndex; // NOTE: the material every live lane hit, when uniform
+};
+
+// NOTE: lanes outside laneMask take the live lanes' material when they all agree, whatever those lanes
+// compute is masked out
+static MaterialLookup LookupMaterials(lane_u32 indices, lane_u32 laneMask)
+{
+	MaterialLookup result;
+	result.indices = indices;
+	result.uniform = false;
+	result.uniformIndex = 0;
+
+	u32 liveBits = MaskBits(laneMask);
+	if (liveBits)
+	{
+		u32 firstLane = 0;
+		while (!(liveBits & (1u << firstLane)))
+		{
+			++firstLane;
+		}
+
+		u32 firstIndex = ExtractLane(indices, firstLane);
+		result.uniform = MaskIsZero(laneMask & (indices != LaneU32FromU32(firstIndex)));
+		result.uniformIndex = firstIndex;
+	}
+
+	return result;
+}
+
+static lane_f32 MaterialF32(MaterialLookup* lookup, f32* component)
+{
+	lane_f32 result;
+	if (lookup->uniform)
+	{
+		result = LaneF32FromF32(component[lookup->uniformIndex]);
+	}
+	else
+	{
+		result = GatherPackedF32(component, lookup->indices);
+	}
+
+	return result;
+}
+
+static lane_u32 MaterialU32(MaterialLookup* lookup, u32* component)
+{
+	lane_u32 result;
+	if (lookup->uniform)
+	{
+		result = LaneU32FromU32(component[lookup->uniformIndex]);
+	}
+	else
+	{
+		result = GatherPackedU32(component, lookup->indices);
+	}
+
+	return result;
+}
+
+static lane_v3 MaterialV3(MaterialLookup* lookup, f32* x, f32* y, f32* z)
+{
+	lane_v3 result = LaneV3(MaterialF32(lookup, x), MaterialF32(lookup, y), MaterialF32(lookup, z));
+	return result;
+}
+
+#endif
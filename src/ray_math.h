@@ -29,6 +29,36 @@ inline f32 Clamp01(f32 value)
 	return result;
 }
 
+inline f32 MinF32(f32 a, f32 b)
+{
+	f32 result = a < b ? a : b;
+	return result;
+}
+
+inline f32 MaxF32(f32 a, f32 b)
+{
+	f32 result = a > b ? a : b;
+	return result;
+}
+
+inline u32 MinU32(u32 a, u32 b)
+{
+	u32 result = a < b ? a : b;
+	return result;
+}
+
+inline u32 MaxU32(u32 a, u32 b)
+{
+	u32 result = a > b ? a : b;
+	return result;
+}
+
+inline f32 AxisValue(vec3 v, u32 axis)
+{
+	f32 result = (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+	return result;
+}
+
 inline i32 SignOf(i32 a)
 {
 	i32 result = a >= 0 ? 1 : -1;
@@ -385,6 +415,21 @@ inline lane_v3 Lerp(lane_v3 a, lane_v3 b, lane_f32 t)
 	return result;
 }
 
+// NOTE: sine and cosine of t full turns, t in [0, 1]. The lanes have no trig, so this goes through the
+// half angle a = pi * (t - 0.5) in [-pi/2, pi/2], where the Taylor series to a^11 is good to 1e-7
+inline void SinCosTurns(lane_f32 t, lane_f32* sinResult, lane_f32* cosResult)
+{
+	lane_f32 a = 3.14159265f * (t - 0.5f);
+	lane_f32 a2 = a * a;
+	lane_f32 s = a * (1.0f + a2 * (-1.0f / 6.0f + a2 * (1.0f / 120.0f + a2 * (-1.0f / 5040.0f +
+		a2 * (1.0f / 362880.0f + a2 * (-1.0f / 39916800.0f))))));
+	lane_f32 c = SquareRoot(Max(1.0f - s * s, LaneF32FromF32(0.0f)));
+
+	// NOTE: 2a is the angle minus a half turn, which flips both signs
+	*sinResult = -2.0f * s * c;
+	*cosResult = 2.0f * s * s - 1.0f;
+}
+
 inline f32 LinearToSRGB255(f32 l)
 {
 	f32 s;
@@ -0,0 +1,144 @@
+#if !defined RAY_OBJ_H
+# define RAY_OBJ_H
+
+//
+// Wavefront OBJ loading
+//
+// NOTE: only positions (v) and faces (f) are read, polygons are fan triangulated
+// and every triangle of the mesh gets the same material index.
+//
+
+// NOTE: "12", "12/3", "12//4" and "12/3/4" all name vertex 12, the rest is ignored
+static char* SkipFaceCorner(char* at)
+{
+	while (!IsLineEnd(*at) && *at != ' ' && *at != '\t')
+	{
+		++at;
+	}
+
+	return at;
+}
+
+static u32 CountFaceCorners(char* at)
+{
+	u32 result = 0;
+	at = SkipSpaces(at);
+	while (!IsLineEnd(*at))
+	{
+		++result;
+		at = SkipSpaces(SkipFaceCorner(at));
+	}
+
+	return result;
+}
+
+static bool LoadOBJ(World* world, const char* fileName, u32 matIndex, vec3 offset, f32 scale)
+{
+	EntireFile file = ReadEntireFile(fileName);
+	if (!file.contents)
+	{
+		fprintf(stderr, "[ERROR] Unable to read OBJ file %s.\n", fileName);
+		return false;
+	}
+
+	// NOTE: first pass only counts, so the buffers grow once per mesh rather than per triangle
+	u32 vertexCount = 0;
+	u32 triangleCount = 0;
+	for (char* at = file.contents; *at; at = NextLine(at))
+	{
+		at = SkipSpaces(at);
+		if (at[0] == 'v' && (at[1] == ' ' || at[1] == '\t'))
+		{
+			++vertexCount;
+		}
+		else if (at[0] == 'f' && (at[1] == ' ' || at[1] == '\t'))
+		{
+			u32 cornerCount = CountFaceCorners(at + 1);
+			if (cornerCount >= 3)
+			{
+				triangleCount += cornerCount - 2;
+			}
+		}
+	}
+
+	u32 firstVertex = world->vertexCount;
+	u32 firstTriangle = world->triangleCount;
+	world->vertices = (vec3*)realloc(world->vertices, sizeof(vec3) * (firstVertex + vertexCount));
+	world->triangles = (Triangle*)realloc(world->triangles, sizeof(Triangle) * (firstTriangle + triangleCount));
+
+	bool valid = true;
+	u32 meshVertexCount = 0;
+	u32 meshTriangleCount = 0;
+	u32 lineNumber = 1;
+	for (char* at = file.contents; *at && valid; at = NextLine(at), ++lineNumber)
+	{
+		at = SkipSpaces(at);
+		if (at[0] == 'v' && (at[1] == ' ' || at[1] == '\t'))
+		{
+			char* end = at + 1;
+			vec3 p;
+			p.x = strtof(end, &end);
+			p.y = strtof(end, &end);
+			p.z = strtof(end, &end);
+
+			vec3* vertex = &world->vertices[firstVertex + meshVertexCount++];
+			vertex->x = offset.x + scale * p.x;
+			vertex->y = offset.y + scale * p.y;
+			vertex->z = offset.z + scale * p.z;
+		}
+		else if (at[0] == 'f' && (at[1] == ' ' || at[1] == '\t'))
+		{
+			u32 cornerCount = 0;
+			u32 corners[3];
+			at = SkipSpaces(at + 1);
+			while (!IsLineEnd(*at))
+			{
+				// NOTE: negative indices count back from the last vertex read so far
+				long index = strtol(at, 0, 10);
+				long resolved = (index < 0) ? (long)meshVertexCount + index : index - 1;
+				if (index == 0 || resolved < 0 || resolved >= (long)meshVertexCount)
+				{
+					fprintf(stderr, "[ERROR] %s:%u: face references missing vertex %ld.\n", fileName, lineNumber, index);
+					valid = false;
+					break;
+				}
+
+				u32 vertexIndex = firstVertex + (u32)resolved;
+				if (cornerCount < 3)
+				{
+					corners[cornerCount] = vertexIndex;
+				}
+				else
+				{
+					corners[1] = corners[2];
+					corners[2] = vertexIndex;
+				}
+				++cornerCount;
+
+				if (cornerCount >= 3)
+				{
+					Triangle* triangle = &world->triangles[firstTriangle + meshTriangleCount++];
+					triangle->vertexIndex[0] = corners[0];
+					triangle->vertexIndex[1] = corners[1];
+					triangle->vertexIndex[2] = corners[2];
+					triangle->matIndex = matIndex;
+				}
+
+				at = SkipSpaces(SkipFaceCorner(at));
+			}
+		}
+	}
+
+	free(file.contents);
+
+	if (valid)
+	{
+		assert(meshVertexCount == vertexCount && meshTriangleCount == triangleCount);
+		world->vertexCount += meshVertexCount;
+		world->triangleCount += meshTriangleCount;
+	}
+
+	return valid;
+}
+
+#endif
@@ -0,0 +1,294 @@
+#if !defined RAY_PACKET_H
+# define RAY_PACKET_H
+
+//
+// Camera ray packets
+//
+// Every camera ray of a block starts at the camera and passes through the block's patch of film, so
+// they all lie inside one frustum. Before the block is cast, the BVHs are walked once with that
+// frustum and the primitives it reaches are copied out leaf by leaf, front to back. The first
+// bounce then tests its rays against that short list instead of walking the BVHs from the root for
+// every lane batch, see IntersectCameraRays. When the frustum reaches more of a BVH than the packet
+// holds, the far parts stay whole subtrees that the rays traverse as usual.
+//
+
+#define PACKET_MAX_NODE_COUNT 32
+// NOTE: sphere leaves grow to the lane width, see GetSphereLeafWidth
+#define PACKET_MAX_PRIM_COUNT (PACKET_MAX_NODE_COUNT * MAX_LANE_WIDTH)
+
+// NOTE: the four side planes of a block's camera rays, normals pointing inward. They meet at the
+// camera, so only what's in front of it is inside
+struct Frustum
+{
+	vec3 apex;
+	vec3 centerDir;
+	vec3 cornerDirs[4];
+	vec3 normals[4];
+};
+
+static vec3 FilmDir(Camera* camera, f32 offX, f32 offY)
+{
+	vec3 filmPos = camera->filmCenter + (offX * 0.5f * camera->filmW) * camera->x + (offY * 0.5f * camera->filmH) * camera->y;
+	vec3 result = filmPos - camera->pos;
+	return result;
+}
+
+// NOTE: the kernel jitters a ray within its pixel's film cell, the frustum is a pixel wider on every
+// side so rounding never puts a camera ray outside of it
+static Frustum MakeBlockFrustum(Camera* camera, u32 imageWidth, u32 imageHeight, u32 minX, u32 maxX, u32 minY, u32 maxY)
+{
+	f32 loX = -1.0f + 2.0f * (((f32)minX - 1.0f) / (f32)imageWidth);
+	f32 hiX = -1.0f + 2.0f * (((f32)maxX + 1.0f) / (f32)imageWidth);
+	f32 loY = -1.0f + 2.0f * (((f32)minY - 1.0f) / (f32)imageHeight);
+	f32 hiY = -1.0f + 2.0f * (((f32)maxY + 1.0f) / (f32)imageHeight);
+
+	Frustum result;
+	result.apex = camera->pos;
+	result.centerDir = FilmDir(camera, 0.5f * (loX + hiX), 0.5f * (loY + hiY));
+	result.cornerDirs[0] = FilmDir(camera, loX, loY);
+	result.cornerDirs[1] = FilmDir(camera, hiX, loY);
+	result.cornerDirs[2] = FilmDir(camera, hiX, hiY);
+	result.cornerDirs[3] = FilmDir(camera, loX, hiY);
+	for (u32 edgeIndex = 0; edgeIndex < 4; ++edgeIndex)
+	{
+		vec3 normal = Cross(result.cornerDirs[edgeIndex], result.cornerDirs[(edgeIndex + 1) % 4]);
+		if (Dot(normal, result.centerDir) < 0.0f)
+		{
+			normal = -normal;
+		}
+		result.normals[edgeIndex] = normal;
+	}
+
+	return result;
+}
+
+// NOTE: false only if the box is wholly outside one of the planes, so a few boxes outside the corners pass
+static bool FrustumTouchesAABB(Frustum* frustum, AABB* box)
+{
+	for (u32 planeIndex = 0; planeIndex < 4; ++planeIndex)
+	{
+		vec3 n = frustum->normals[planeIndex];
+		vec3 farCorner = Vec3(n.x > 0.0f ? box->max.x : box->min.x,
+			n.y > 0.0f ? box->max.y : box->min.y,
+			n.z > 0.0f ? box->max.z : box->min.z);
+		if (Dot(n, farCorner - frustum->apex) < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool FrustumTouchesSphere(Frustum* frustum, vec3 center, f32 radius)
+{
+	for (u32 planeIndex = 0; planeIndex < 4; ++planeIndex)
+	{
+		vec3 n = frustum->normals[planeIndex];
+		if (Dot(n, center - frustum->apex) < -radius * VecLength(n))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool FrustumTouchesTriangle(Frustum* frustum, vec3 v0, vec3 v1, vec3 v2)
+{
+	for (u32 planeIndex = 0; planeIndex < 4; ++planeIndex)
+	{
+		vec3 n = frustum->normals[planeIndex];
+		if (Dot(n, v0 - frustum->apex) < 0.0f && Dot(n, v1 - frustum->apex) < 0.0f && Dot(n, v2 - frustum->apex) < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// NOTE: a camera ray hits the plane where it crosses it, going from the camera's side to the other.
+// Across the frustum how fast the rays approach is linear, so if none of the corner rays do, none do
+static bool FrustumTouchesPlane(Frustum* frustum, vec3 normal, f32 dist)
+{
+	f32 side = Dot(normal, frustum->apex) + dist;
+	for (u32 cornerIndex = 0; cornerIndex < 4; ++cornerIndex)
+	{
+		if (side * Dot(normal, frustum->cornerDirs[cornerIndex]) < 0.0f)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void AllocateRayPacket(RayPacket* packet, World* world)
+{
+	u32 planeStride = GetPaddedPrimCount(world->planeCount);
+	packet->planes.nx = (f32*)calloc(planeStride, sizeof(f32));
+	packet->planes.ny = (f32*)calloc(planeStride, sizeof(f32));
+	packet->planes.nz = (f32*)calloc(planeStride, sizeof(f32));
+	packet->planes.dist = (f32*)calloc(planeStride, sizeof(f32));
+	packet->planes.matIndex = (u32*)calloc(planeStride, sizeof(u32));
+
+	u32 sphereStride = GetPaddedPrimCount(PACKET_MAX_PRIM_COUNT);
+	packet->spheres.x = (f32*)calloc(sphereStride, sizeof(f32));
+	packet->spheres.y = (f32*)calloc(sphereStride, sizeof(f32));
+	packet->spheres.z = (f32*)calloc(sphereStride, sizeof(f32));
+	packet->spheres.radius = (f32*)calloc(sphereStride, sizeof(f32));
+	packet->spheres.matIndex = (u32*)calloc(sphereStride, sizeof(u32));
+	packet->sphereNodes.nodes = (BVHNode*)calloc(PACKET_MAX_NODE_COUNT, sizeof(BVHNode));
+
+	packet->triangles = (Triangle*)calloc(PACKET_MAX_PRIM_COUNT, sizeof(Triangle));
+	packet->triangleNodes.nodes = (BVHNode*)calloc(PACKET_MAX_NODE_COUNT, sizeof(BVHNode));
+}
+
+static void FreeRayPacket(RayPacket* packet)
+{
+	free(packet->planes.nx);
+	free(packet->planes.ny);
+	free(packet->planes.nz);
+	free(packet->planes.dist);
+	free(packet->planes.matIndex);
+
+	free(packet->spheres.x);
+	free(packet->spheres.y);
+	free(packet->spheres.z);
+	free(packet->spheres.radius);
+	free(packet->spheres.matIndex);
+	free(packet->sphereNodes.nodes);
+
+	free(packet->triangles);
+	free(packet->triangleNodes.nodes);
+}
+
+// NOTE: copies the primitives of a leaf that the frustum reaches, with bounds around just those
+static void AddPacketLeaf(RayPacket* packet, World* world, Frustum* frustum, u32 primitiveType, BVHNode* node,
+	PacketNodes* nodes, u32* primCount)
+{
+	BVHNode leaf;
+	leaf.bounds = EmptyAABB();
+	leaf.firstIndex = *primCount;
+	leaf.splitAxis = 0;
+	for (u32 primIndex = node->firstIndex; primIndex < node->firstIndex + node->primCount; ++primIndex)
+	{
+		if (primitiveType == PRIMITIVE_TRIANGLE)
+		{
+			Triangle* triangle = &world->triangles[primIndex];
+			vec3 v0 = world->vertices[triangle->vertexIndex[0]];
+			vec3 v1 = world->vertices[triangle->vertexIndex[1]];
+			vec3 v2 = world->vertices[triangle->vertexIndex[2]];
+			if (FrustumTouchesTriangle(frustum, v0, v1, v2))
+			{
+				packet->triangles[*primCount] = *triangle;
+				leaf.bounds = Union(Union(Union(leaf.bounds, v0), v1), v2);
+				++*primCount;
+			}
+		}
+		else
+		{
+			Sphere* sphere = &world->spheres[primIndex];
+			if (FrustumTouchesSphere(frustum, sphere->pos, sphere->radius))
+			{
+				SphereSoA* spheres = &packet->spheres;
+				spheres->x[*primCount] = sphere->pos.x;
+				spheres->y[*primCount] = sphere->pos.y;
+				spheres->z[*primCount] = sphere->pos.z;
+				spheres->radius[*primCount] = sphere->radius;
+				spheres->matIndex[*primCount] = sphere->matIndex;
+				vec3 extent = Vec3(sphere->radius);
+				leaf.bounds = Union(Union(leaf.bounds, sphere->pos - extent), sphere->pos + extent);
+				++*primCount;
+			}
+		}
+	}
+
+	leaf.primCount = (u16)(*primCount - leaf.firstIndex);
+	if (leaf.primCount > 0)
+	{
+		nodes->nodes[nodes->nodeCount++] = leaf;
+	}
+}
+
+// NOTE: the walk takes the near child first as seen along the block's center ray, so the list comes
+// out roughly front to back and the closer leaves shorten the rays before the far ones are tested.
+// A node is only opened while every node still on the stack keeps room for an entry of its own
+static void CollectPacketNodes(RayPacket* packet, World* world, Frustum* frustum, BVH* bvh, u32 primitiveType,
+	PacketNodes* nodes)
+{
+	nodes->nodeCount = 0;
+	if (bvh->nodeCount == 0)
+	{
+		return;
+	}
+
+	u32 primCount = 0;
+	u32 stack[BVH_STACK_SIZE];
+	u32 stackCount = 0;
+	stack[stackCount++] = 0;
+	while (stackCount > 0)
+	{
+		u32 nodeIndex = stack[--stackCount];
+		BVHNode* node = &bvh->nodes[nodeIndex];
+		if (!FrustumTouchesAABB(frustum, &node->bounds))
+		{
+			continue;
+		}
+
+		bool roomForLeaf = (primCount + node->primCount <= PACKET_MAX_PRIM_COUNT);
+		bool roomForChildren = (nodes->nodeCount + stackCount + 2 <= PACKET_MAX_NODE_COUNT);
+		if (node->primCount > 0 && roomForLeaf)
+		{
+			AddPacketLeaf(packet, world, frustum, primitiveType, node, nodes, &primCount);
+		}
+		else if (node->primCount == 0 && roomForChildren)
+		{
+			assert(stackCount + 2 <= BVH_STACK_SIZE);
+			u32 nearChild = node->firstIndex;
+			u32 farChild = node->firstIndex + 1;
+			if (AxisValue(frustum->centerDir, node->splitAxis) < 0.0f)
+			{
+				nearChild = node->firstIndex + 1;
+				farChild = node->firstIndex;
+			}
+			stack[stackCount++] = farChild;
+			stack[stackCount++] = nearChild;
+		}
+		else
+		{
+			BVHNode subtree = *node;
+			subtree.firstIndex = nodeIndex;
+			subtree.primCount = 0;
+			nodes->nodes[nodes->nodeCount++] = subtree;
+		}
+	}
+}
+
+static void BuildRayPacket(RayPacket* packet, World* world, Camera* camera, u32 imageWidth, u32 imageHeight,
+	u32 minX, u32 maxX, u32 minY, u32 maxY)
+{
+	Frustum frustum = MakeBlockFrustum(camera, imageWidth, imageHeight, minX, maxX, minY, maxY);
+
+	packet->planeCount = 0;
+	for (u32 planeIndex = 0; planeIndex < world->planeCount; ++planeIndex)
+	{
+		Plane* plane = &world->planes[planeIndex];
+		if (FrustumTouchesPlane(&frustum, plane->normal, plane->dist))
+		{
+			PlaneSoA* planes = &packet->planes;
+			planes->nx[packet->planeCount] = plane->normal.x;
+			planes->ny[packet->planeCount] = plane->normal.y;
+			planes->nz[packet->planeCount] = plane->normal.z;
+			planes->dist[packet->planeCount] = plane->dist;
+			planes->matIndex[packet->planeCount] = plane->matIndex;
+			++packet->planeCount;
+		}
+	}
+
+	CollectPacketNodes(packet, world, &frustum, &world->sphereBVH, PRIMITIVE_SPHERE, &packet->sphereNodes);
+	CollectPacketNodes(packet, world, &frustum, &world->triangleBVH, PRIMITIVE_TRIANGLE, &packet->triangleNodes);
+}
+
+#endif
@@ -0,0 +1,194 @@
+#if !defined RAY_PATH_H
+# define RAY_PATH_H
+
+//
+// Path tracing, one bounce at a time
+//
+// A lane per path. The per-pixel kernel keeps the samples of one pixel in a PathLanes through all
+// their bounces, the wavefront kernel loads lanes of any paths out of a ray stream and stores them
+// back between stages. Both run the same two steps per bounce after the intersection: AddHitEmission
+// for what the ray found, ScatterPath for where it goes next.
+//
+
+struct PathLanes
+{
+	lane_v3 rayOrigin;
+	lane_v3 rayDir;
+	lane_v3 attenuation;
+	lane_v3 sample; // NOTE: light the path gathered so far
+	lane_u32 laneMask;
+
+	// NOTE: how the ray in flight was scattered, for weighting a light it finds against light sampling.
+	// Camera rays and mirror bounces couldn't have been light samples and keep the whole emission
+	lane_u32 scatterMisMask;
+	lane_f32 scatterPdf;
+
+	Sampler sampler;
+};
+
+struct PathHit
+{
+	lane_f32 dist;
+	lane_u32 material;
+	lane_v3 normal;
+};
+
+static PathLanes StartPath(Sampler sampler, lane_v3 rayOrigin, lane_v3 rayDir)
+{
+	PathLanes result;
+	result.rayOrigin = rayOrigin;
+	result.rayDir = rayDir;
+	result.attenuation = Vec3(1.0f, 1.0f, 1.0f);
+	result.sample = Vec3(0.0f);
+	result.laneMask = LaneU32FromU32(0xffffffff);
+	result.scatterMisMask = LaneU32FromU32(0);
+	result.scatterPdf = LaneF32FromF32(0.0f);
+	result.sampler = sampler;
+
+	return result;
+}
+
+// NOTE: light emitted by whatever the rays hit, then the lanes that hit nothing or a surface from behind,
+// which reflects nothing, are dropped
+static void AddHitEmission(World* world, PathLanes* path, PathHit* hit)
+{
+	MaterialSoA* materials = &world->materialSoA;
+	MaterialLookup lookup = LookupMaterials(hit->material, path->laneMask);
+	lane_v3 emitColor = path->laneMask & MaterialV3(&lookup, materials->emitR, materials->emitG, materials->emitB); // NOTE: must return 0 on laneMask
+
+	if (world->lightCount > 0)
+	{
+		lane_u32 hitLight = MaterialU32(&lookup, materials->lightIndex);
+		lane_u32 misMask = path->laneMask & path->scatterMisMask & (hitLight != LaneU32FromU32(LIGHT_NONE));
+		if (!MaskIsZero(misMask))
+		{
+			lane_u32 lightIndex = LaneU32FromU32(0);
+			ConditionalAssign(&lightIndex, misMask, hitLight);
+			lane_f32 lightPdf = LightPdf(world, lightIndex, path->rayOrigin);
+			ConditionalAssign(&emitColor, misMask, PowerHeuristic(path->scatterPdf, lightPdf) * emitColor);
+		}
+	}
+
+	path->sample += Hadamard(path->attenuation, emitColor);
+
+	lane_f32 cosView = Dot(-path->rayDir, hit->normal);
+	path->laneMask &= (hit->material != LaneU32FromU32(0)) & (cosView > LaneF32FromF32(0.0f));
+}
+
+// NOTE: moves the live lanes to their hits, adds a light sample there and scatters them onward,
+// Russian roulette past rouletteStartBounce
+static void ScatterPath(World* world, PathLanes* path, PathHit* hit, u32 bounce, u32 maxBounceCount, u32 rouletteStartBounce)
+{
+	lane_f32 zero = LaneF32FromF32(0.0f);
+	lane_f32 invPi = LaneF32FromF32(1.0f / 3.14159265f);
+	u32 lightCount = world->lightCount;
+	Sampler* sampler = &path->sampler;
+	lane_u32 laneMask = path->laneMask;
+	lane_v3 nextNormal = hit->normal;
+
+	MaterialSoA* materials = &world->materialSoA;
+	MaterialLookup lookup = LookupMaterials(hit->material, laneMask);
+	lane_v3 reflectColor = MaterialV3(&lookup, materials->reflectR, materials->reflectG, materials->reflectB);
+	lane_f32 matSpecular = MaterialF32(&lookup, materials->specular);
+
+	lane_v3 viewDir = -path->rayDir;
+	lane_f32 cosView = Dot(viewDir, nextNormal);
+	lane_v3 rayOrigin = path->rayOrigin + hit->dist * path->rayDir;
+
+	lane_v3 tangent, bitangent;
+	OrthonormalBasis(nextNormal, &tangent, &bitangent);
+	lane_f32 alpha = 1.0f - matSpecular;
+	lane_u32 glossyMask = laneMask & (matSpecular > zero);
+	// NOTE: mirrors can't be light sampled, a light sample is never exactly the mirror direction
+	lane_u32 nonDeltaMask = laneMask & (alpha > zero);
+
+	// NOTE: next event estimation, skipped at the last bounce whose scattered ray isn't traced, so
+	// both strategies cover the same path lengths
+	if (lightCount > 0 && bounce + 1 < maxBounceCount)
+	{
+		lane_f32 lightU, lightV;
+		Sample2D(sampler, &lightU, &lightV);
+		lane_f32 lightPick = Sample1D(sampler);
+		LightSample light = SampleLight(world, lightPick, lightU, lightV, rayOrigin);
+
+		lane_f32 cosLight = Dot(light.dir, nextNormal);
+		lane_u32 lightMask = nonDeltaMask & light.validMask & (cosLight > zero);
+		if (!MaskIsZero(lightMask))
+		{
+			// NOTE: f cos of the surface toward the light, and the density its own sampling gives that direction
+			lane_v3 lobeValue = (cosLight * invPi) * reflectColor;
+			lane_f32 lobePdf = cosLight * invPi;
+			lane_u32 glossyLightMask = lightMask & glossyMask;
+			if (!MaskIsZero(glossyLightMask))
+			{
+				lane_v3 halfVector = VecNormalize(viewDir + light.dir);
+				lane_f32 cosHalf = Dot(nextNormal, halfVector);
+				lane_f32 distribution = GGXDistribution(alpha, cosHalf);
+				lane_f32 masking = SmithMaskingGGX(alpha, cosView) * SmithMaskingGGX(alpha, cosLight);
+				ConditionalAssign(&lobeValue, glossyLightMask, (distribution * masking / (4.0f * cosView)) * reflectColor);
+				ConditionalAssign(&lobePdf, glossyLightMask, distribution * cosHalf / (4.0f * Dot(viewDir, halfVector)));
+			}
+
+			lane_u32 visibleMask = IsUnoccluded(world, rayOrigin, light.dir, (1.0f - LIGHT_DIST_EPSILON) * light.dist, lightMask);
+			if (!MaskIsZero(visibleMask))
+			{
+				lane_f32 lightWeight = PowerHeuristic(light.pdf, lobePdf) / light.pdf;
+				path->sample += visibleMask & Hadamard(path->attenuation, lightWeight * Hadamard(lobeValue, light.emitColor));
+			}
+		}
+	}
+
+	lane_f32 scatterU, scatterV;
+	Sample2D(sampler, &scatterU, &scatterV);
+
+	// NOTE: the cosine and the 1 / pi of the diffuse lobe are both in the sampling density
+	lane_v3 rayDir = SampleCosineHemisphere(scatterU, scatterV, tangent, bitangent, nextNormal);
+	lane_v3 weight = reflectColor;
+	lane_f32 scatterPdf = Dot(rayDir, nextNormal) * invPi;
+
+	if (!MaskIsZero(glossyMask))
+	{
+		lane_v3 microNormal = SampleGGXNormal(alpha, scatterU, scatterV, tangent, bitangent, nextNormal);
+		lane_f32 cosViewMicro = Dot(viewDir, microNormal);
+		lane_f32 cosMicro = Dot(nextNormal, microNormal);
+		lane_v3 glossyDir = (2.0f * cosViewMicro) * microNormal - viewDir;
+		lane_f32 cosLight = Dot(glossyDir, nextNormal);
+
+		// NOTE: f cos / pdf of the microfacet lobe, the reflect color stands in for Fresnel. A ray
+		// reflected below the surface carries nothing and is dropped
+		lane_u32 aboveMask = glossyMask & (cosLight > zero);
+		lane_f32 glossyWeight = SmithMaskingGGX(alpha, cosView) * SmithMaskingGGX(alpha, cosLight) *
+			cosViewMicro / (cosView * cosMicro);
+		ConditionalAssign(&rayDir, glossyMask, glossyDir);
+		ConditionalAssign(&weight, glossyMask, Vec3(0.0f));
+		ConditionalAssign(&weight, aboveMask, glossyWeight * reflectColor);
+		ConditionalAssign(&laneMask, glossyMask, aboveMask);
+		if (lightCount > 0)
+		{
+			ConditionalAssign(&scatterPdf, glossyMask & nonDeltaMask,
+				GGXDistribution(alpha, cosMicro) * cosMicro / (4.0f * cosViewMicro));
+		}
+	}
+
+	lane_v3 attenuation = Hadamard(path->attenuation, weight);
+
+	// NOTE: Russian roulette, past the start bounce a path goes on with probability p and carries
+	// 1 / p more, so the expected image stays the same. p follows the throughput, so paths that
+	// can't add much end early, and stays below 1 so even bright paths end eventually
+	if (bounce + 1 >= rouletteStartBounce && bounce + 1 < maxBounceCount)
+	{
+		lane_f32 survival = Min(Max(Max(attenuation.x, attenuation.y), attenuation.z), LaneF32FromF32(ROULETTE_MAX_SURVIVAL));
+		lane_u32 surviveMask = laneMask & (Sample1D(sampler) < survival);
+		ConditionalAssign(&attenuation, surviveMask, (1.0f / survival) * attenuation);
+		laneMask = surviveMask;
+	}
+
+	path->rayOrigin = rayOrigin;
+	path->rayDir = rayDir;
+	path->attenuation = attenuation;
+	path->laneMask = laneMask;
+	path->scatterMisMask = nonDeltaMask;
+	path->scatterPdf = scatterPdf;
+}
+
+#endif
@@ -0,0 +1,139 @@
+#if !defined RAY_SAMPLER_H
+# define RAY_SAMPLER_H
+
+//
+// Samplers
+//
+// The kernel asks for the dimensions of a sample in order, two at a time where they belong together
+// (film x and y, a bounce direction) and one at a time otherwise, and doesn't know where they come
+// from. SAMPLER_RANDOM is the white noise of random_gen.h. SAMPLER_SOBOL is an Owen scrambled Sobol
+// (0,2)-sequence, padded to any number of dimensions by shuffling the sample order of every pair
+// separately, after Burley, "Practical Hash-based Owen Scrambling", JCGT 2020. Both draw the same
+// numbers for a sample whatever the lane width, and keep their state per lane so the wavefront kernel
+// can put samples of different pixels side by side.
+//
+
+struct Sampler
+{
+	u32 kind;
+	lane_u32 pixelSeed;
+	lane_u32 reversedSampleIndex;
+	u32 pairIndex; // NOTE: Sobol dimension pairs handed out so far
+	RandomSeries series;
+};
+
+static lane_u32 ReverseBits(lane_u32 x)
+{
+	x = ((x >> 1) & LaneU32FromU32(0x55555555)) | ((x & LaneU32FromU32(0x55555555)) << 1);
+	x = ((x >> 2) & LaneU32FromU32(0x33333333)) | ((x & LaneU32FromU32(0x33333333)) << 2);
+	x = ((x >> 4) & LaneU32FromU32(0x0F0F0F0F)) | ((x & LaneU32FromU32(0x0F0F0F0F)) << 4);
+	x = ((x >> 8) & LaneU32FromU32(0x00FF00FF)) | ((x & LaneU32FromU32(0x00FF00FF)) << 8);
+	x = (x >> 16) | (x << 16);
+
+	return x;
+}
+
+// NOTE: every bit only depends on the bits below it, so on reversed bits this is a nested uniform scramble
+static lane_u32 LaineKarrasPermutation(lane_u32 x, lane_u32 seed)
+{
+	x += seed;
+	x ^= x * LaneU32FromU32(0x6C50B47C);
+	x ^= x * LaneU32FromU32(0xB82F1E52);
+	x ^= x * LaneU32FromU32(0xC7AFE638);
+	x ^= x * LaneU32FromU32(0x8D22F6E6);
+
+	return x;
+}
+
+// NOTE: the first Sobol dimension is the van der Corput sequence, reversed bits, so this takes an
+// unreversed value and skips the reversals on the way in
+static lane_u32 OwenScrambleReversed(lane_u32 x, lane_u32 seed)
+{
+	lane_u32 result = ReverseBits(LaineKarrasPermutation(x, seed));
+	return result;
+}
+
+// NOTE: the second Sobol dimension, returned bit reversed. Its generator matrix is Pascal's triangle
+// mod 2, so digit r is the parity of the index bits j with r a subset of j (Lucas), which is a subset
+// sum over the 5 bits of the bit position, one shift per bit instead of a loop over the index bits
+static lane_u32 SobolDimension1Reversed(lane_u32 index)
+{
+	lane_u32 result = index;
+	result ^= (result >> 1) & LaneU32FromU32(0x55555555);
+	result ^= (result >> 2) & LaneU32FromU32(0x33333333);
+	result ^= (result >> 4) & LaneU32FromU32(0x0F0F0F0F);
+	result ^= (result >> 8) & LaneU32FromU32(0x00FF00FF);
+	result ^= (result >> 16) & LaneU32FromU32(0x0000FFFF);
+
+	return result;
+}
+
+static lane_f32 UnitFromU32(lane_u32 x)
+{
+	// NOTE: 24 bits fit the mantissa exactly, the result stays below one
+	lane_f32 result = LaneF32FromU32(x >> 8) * (1.0f / 16777216.0f);
+	return result;
+}
+
+// NOTE: lane i draws sample firstSampleIndex + i
+static Sampler StartSample(u32 kind, u32 pixelIndex, u32 firstSampleIndex)
+{
+	Sampler result;
+	result.kind = kind;
+	result.pixelSeed = HashU32(LaneU32FromU32(pixelIndex));
+	result.reversedSampleIndex = ReverseBits(LaneU32FromU32(firstSampleIndex) + LaneIndices());
+	result.pairIndex = 0;
+	if (kind == SAMPLER_RANDOM)
+	{
+		result.series = StartRandomSeries(pixelIndex, firstSampleIndex);
+	}
+
+	return result;
+}
+
+// NOTE: every pair gets its own seed and its own shuffled order of the samples, which keeps the pairs
+// from correlating with each other
+static lane_u32 NextSobolPair(Sampler* sampler, lane_u32* pairSeed)
+{
+	*pairSeed = HashU32(sampler->pixelSeed ^ LaneU32FromU32(sampler->pairIndex * 0x9E3779B9));
+	++sampler->pairIndex;
+
+	lane_u32 result = ReverseBits(LaineKarrasPermutation(sampler->reversedSampleIndex, *pairSeed));
+	return result;
+}
+
+static void Sample2D(Sampler* sampler, lane_f32* u, lane_f32* v)
+{
+	if (sampler->kind == SAMPLER_SOBOL)
+	{
+		lane_u32 pairSeed;
+		lane_u32 index = NextSobolPair(sampler, &pairSeed);
+		*u = UnitFromU32(OwenScrambleReversed(index, HashU32(pairSeed + LaneU32FromU32(1))));
+		*v = UnitFromU32(OwenScrambleReversed(SobolDimension1Reversed(index), HashU32(pairSeed + LaneU32FromU32(2))));
+	}
+	else
+	{
+		*u = RandomFloatUni(&sampler->series);
+		*v = RandomFloatUni(&sampler->series);
+	}
+}
+
+static lane_f32 Sample1D(Sampler* sampler)
+{
+	lane_f32 result;
+	if (sampler->kind == SAMPLER_SOBOL)
+	{
+		// NOTE: a pair of its own, only the first dimension is drawn
+		lane_u32 pairSeed;
+		lane_u32 index = NextSobolPair(sampler, &pairSeed);
+		result = UnitFromU32(OwenScrambleReversed(index, HashU32(pairSeed + LaneU32FromU32(1))));
+	}
+	else
+	{
+		result = RandomFloatUni(&sampler->series);
+	}
+
+	return result;
+}
+
+#endif
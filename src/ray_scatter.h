@@ -0,0 +1,72 @@
+#if !defined RAY_SCATTER_H
+# define RAY_SCATTER_H
+
+//
+// Scattering
+//
+// Bounce directions drawn in proportion to what the material sends that way, so the path weight is
+// the albedo or close to it and no sample is spent on directions that hardly contribute. A specular
+// of 0 is a Lambertian diffuse lobe, cosine weighted around the normal. Anything above is a GGX
+// microfacet lobe with roughness 1 - specular, its normals importance sampled and the path weighted
+// by the Smith masking that's left over, down to a perfect mirror at 1.
+//
+
+// NOTE: tangent and bitangent for a unit normal without a branch or a cross product, after Duff et al.,
+// "Building an Orthonormal Basis, Revisited", JCGT 2017
+static void OrthonormalBasis(lane_v3 normal, lane_v3* tangent, lane_v3* bitangent)
+{
+	lane_f32 sign = LaneF32FromF32(1.0f);
+	ConditionalAssign(&sign, normal.z < LaneF32FromF32(0.0f), LaneF32FromF32(-1.0f));
+
+	lane_f32 a = -1.0f / (sign + normal.z);
+	lane_f32 b = normal.x * normal.y * a;
+	*tangent = LaneV3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+	*bitangent = LaneV3(b, sign + normal.y * normal.y * a, -normal.y);
+}
+
+// NOTE: a point on the unit disk, r = sqrt(u), lifted onto the hemisphere has density cos / pi
+static lane_v3 SampleCosineHemisphere(lane_f32 u, lane_f32 v, lane_v3 tangent, lane_v3 bitangent, lane_v3 normal)
+{
+	lane_f32 sinPhi, cosPhi;
+	SinCosTurns(v, &sinPhi, &cosPhi);
+	lane_f32 r = SquareRoot(u);
+	lane_f32 cosTheta = SquareRoot(Max(1.0f - u, LaneF32FromF32(0.0f)));
+
+	lane_v3 result = (r * cosPhi) * tangent + (r * sinPhi) * bitangent + cosTheta * normal;
+	return result;
+}
+
+// NOTE: a microfacet normal with density D(m) (n.m). The inverse CDF is tan^2 = alpha^2 u / (1 - u),
+// written so alpha 0 gives the normal itself; u stays below 1, white noise can return exactly 1
+static lane_v3 SampleGGXNormal(lane_f32 alpha, lane_f32 u, lane_f32 v, lane_v3 tangent, lane_v3 bitangent, lane_v3 normal)
+{
+	u = Min(u, LaneF32FromF32(0.99999994f));
+	lane_f32 sinPhi, cosPhi;
+	SinCosTurns(v, &sinPhi, &cosPhi);
+	lane_f32 cosThetaSq = (1.0f - u) / (1.0f - u + alpha * alpha * u);
+	lane_f32 cosTheta = SquareRoot(cosThetaSq);
+	lane_f32 sinTheta = SquareRoot(Max(1.0f - cosThetaSq, LaneF32FromF32(0.0f)));
+
+	lane_v3 result = (sinTheta * cosPhi) * tangent + (sinTheta * sinPhi) * bitangent + cosTheta * normal;
+	return result;
+}
+
+// NOTE: the GGX normal distribution D(m), cosine from the macro normal. Undefined for alpha 0, a mirror
+// reflects a single direction and is never evaluated, only sampled
+static lane_f32 GGXDistribution(lane_f32 alpha, lane_f32 cosTheta)
+{
+	lane_f32 alphaSq = alpha * alpha;
+	lane_f32 denom = cosTheta * cosTheta * (alphaSq - 1.0f) + 1.0f;
+	lane_f32 result = alphaSq / (3.14159265f * denom * denom);
+	return result;
+}
+
+// NOTE: Smith G1 for GGX, cosine from the macro normal, 1 everywhere for alpha 0
+static lane_f32 SmithMaskingGGX(lane_f32 alpha, lane_f32 cosTheta)
+{
+	lane_f32 alphaSq = alpha * alpha;
+	lane_f32 result = 2.0f * cosTheta / (cosTheta + SquareRoot(alphaSq + (1.0f - alphaSq) * cosTheta * cosTheta));
+	return result;
+}
+
+#endif
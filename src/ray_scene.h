@@ -0,0 +1,443 @@
+#if !defined RAY_SCENE_H
+# define RAY_SCENE_H
+
+//
+// Scene description files
+//
+// One directive per line, '#' starts a comment:
+//
+//   image <width> <height>
+//   samples <rays per pixel>
+//   bounces <max bounce count>
+//   roulette <start bounce>   (Russian roulette past this many bounces, bounces or more turns it off)
+//   adaptive <error threshold> [<min rays per pixel>]   (samples becomes the cap)
+//   sampler random|sobol
+//   output <file.bmp>
+//   camera <pos x y z> <target x y z>
+//   material <emit r g b> <reflect r g b> <specular>   (indexed in order, 0 is the sky)
+//   plane <normal x y z> <dist> <material>
+//   sphere <pos x y z> <radius> <material>
+//   mesh <file.obj> <material> [<offset x y z> <scale>]
+//
+// Relative mesh paths are resolved against the scene file's directory.
+//
+
+struct SceneParser
+{
+	char* at;
+	const char* fileName;
+	u32 lineNumber;
+	bool valid;
+};
+
+static void SceneError(SceneParser* parser, const char* message)
+{
+	if (parser->valid)
+	{
+		fprintf(stderr, "[ERROR] %s:%u: %s.\n", parser->fileName, parser->lineNumber, message);
+	}
+	parser->valid = false;
+}
+
+static f32 ParseF32(SceneParser* parser)
+{
+	char* end;
+	f32 result = strtof(parser->at, &end);
+	if (end == parser->at)
+	{
+		SceneError(parser, "expected a number");
+	}
+	parser->at = end;
+
+	return result;
+}
+
+static u32 ParseU32(SceneParser* parser)
+{
+	parser->at = SkipSpaces(parser->at);
+	char* end = parser->at;
+	u32 result = 0;
+	if (*parser->at != '-')
+	{
+		result = (u32)strtoul(parser->at, &end, 10);
+	}
+	if (end == parser->at)
+	{
+		SceneError(parser, "expected a non-negative integer");
+	}
+	parser->at = end;
+
+	return result;
+}
+
+static vec3 ParseVec3(SceneParser* parser)
+{
+	vec3 result;
+	result.x = ParseF32(parser);
+	result.y = ParseF32(parser);
+	result.z = ParseF32(parser);
+
+	return result;
+}
+
+// NOTE: terminates the word in place, the line has already been split off
+static char* ParseWord(SceneParser* parser)
+{
+	char* result = SkipSpaces(parser->at);
+	char* end = result;
+	while (*end && *end != ' ' && *end != '\t')
+	{
+		++end;
+	}
+	if (end == result)
+	{
+		SceneError(parser, "expected a word");
+	}
+
+	parser->at = end;
+	if (*end)
+	{
+		*end = 0;
+		++parser->at;
+	}
+
+	return result;
+}
+
+static u32 ParseMaterialIndex(SceneParser* parser, World* world)
+{
+	u32 result = ParseU32(parser);
+	if (parser->valid && result >= world->materialCount)
+	{
+		SceneError(parser, "material is not defined yet");
+	}
+
+	return result;
+}
+
+static char* CopyString(const char* source)
+{
+	size_t length = strlen(source);
+	char* result = (char*)malloc(length + 1);
+	memcpy(result, source, length + 1);
+
+	return result;
+}
+
+// NOTE: amortized doubling, scenes with millions of primitives still grow in a handful of steps
+static void* GrowArray(void* array, u32* capacity, u32 count, size_t elementSize)
+{
+	void* result = array;
+	if (count >= *capacity)
+	{
+		*capacity = (*capacity == 0) ? 16 : 2 * *capacity;
+		result = realloc(array, elementSize * *capacity);
+	}
+
+	return result;
+}
+
+// NOTE: -1 for an unknown name
+static i32 ParseSamplerKind(const char* name)
+{
+	i32 result = -1;
+	if (strcmp(name, "random") == 0)
+	{
+		result = SAMPLER_RANDOM;
+	}
+	else if (strcmp(name, "sobol") == 0)
+	{
+		result = SAMPLER_SOBOL;
+	}
+
+	return result;
+}
+
+static const char* GetSamplerName(u32 samplerKind)
+{
+	const char* result = (samplerKind == SAMPLER_RANDOM) ? "random" : "sobol";
+	return result;
+}
+
+static void InitScene(Scene* scene)
+{
+	*scene = {};
+	scene->cameraPos = { 0.0f, -10.0f, 1.0f };
+	scene->cameraTarget = { 0.0f, 0.0f, 0.0f };
+	scene->imageWidth = 1920;
+	scene->imageHeight = 1080;
+	scene->raysPerPixel = RAYS_PER_PIXEL;
+	scene->maxBounceCount = MAX_BOUNCE_COUNT;
+	scene->rouletteStartBounce = ROULETTE_START_BOUNCE;
+	scene->adaptiveThreshold = 0.0f;
+	scene->minRaysPerPixel = MIN_RAYS_PER_PIXEL;
+	scene->samplerKind = SAMPLER_SOBOL;
+	scene->outputFileName = CopyString("result.bmp");
+}
+
+// NOTE: edits text in place, fileName is used for messages and to resolve mesh paths
+static bool ParseScene(Scene* scene, char* text, const char* fileName)
+{
+	World* world = &scene->world;
+	u32 materialCapacity = 0;
+	u32 planeCapacity = 0;
+	u32 sphereCapacity = 0;
+
+	SceneParser parser = {};
+	parser.fileName = fileName;
+	parser.lineNumber = 1;
+	parser.valid = true;
+
+	char* at = text;
+	while (*at && parser.valid)
+	{
+		char* next = at;
+		while (*next && *next != '\n')
+		{
+			++next;
+		}
+		if (*next == '\n')
+		{
+			++next;
+		}
+
+		// NOTE: cut the line at its end, carriage return or comment
+		char* lineEnd = at;
+		while (!IsLineEnd(*lineEnd))
+		{
+			++lineEnd;
+		}
+		*lineEnd = 0;
+
+		parser.at = SkipSpaces(at);
+		if (*parser.at)
+		{
+			char* keyword = ParseWord(&parser);
+			if (strcmp(keyword, "image") == 0)
+			{
+				scene->imageWidth = ParseU32(&parser);
+				scene->imageHeight = ParseU32(&parser);
+			}
+			else if (strcmp(keyword, "samples") == 0)
+			{
+				scene->raysPerPixel = ParseU32(&parser);
+			}
+			else if (strcmp(keyword, "bounces") == 0)
+			{
+				scene->maxBounceCount = ParseU32(&parser);
+			}
+			else if (strcmp(keyword, "roulette") == 0)
+			{
+				scene->rouletteStartBounce = ParseU32(&parser);
+			}
+			else if (strcmp(keyword, "adaptive") == 0)
+			{
+				scene->adaptiveThreshold = ParseF32(&parser);
+				if (*SkipSpaces(parser.at))
+				{
+					scene->minRaysPerPixel = ParseU32(&parser);
+				}
+			}
+			else if (strcmp(keyword, "sampler") == 0)
+			{
+				char* name = ParseWord(&parser);
+				i32 samplerKind = ParseSamplerKind(name);
+				if (parser.valid && samplerKind < 0)
+				{
+					SceneError(&parser, "unknown sampler, expected random or sobol");
+				}
+				scene->samplerKind = (u32)samplerKind;
+			}
+			else if (strcmp(keyword, "output") == 0)
+			{
+				char* outputFileName = ParseWord(&parser);
+				if (parser.valid)
+				{
+					free(scene->outputFileName);
+					scene->outputFileName = CopyString(outputFileName);
+				}
+			}
+			else if (strcmp(keyword, "camera") == 0)
+			{
+				scene->cameraPos = ParseVec3(&parser);
+				scene->cameraTarget = ParseVec3(&parser);
+			}
+			else if (strcmp(keyword, "material") == 0)
+			{
+				world->materials = (Material*)GrowArray(world->materials, &materialCapacity, world->materialCount, sizeof(Material));
+				Material* material = &world->materials[world->materialCount++];
+				material->emitColor = ParseVec3(&parser);
+				material->reflectColor = ParseVec3(&parser);
+				material->specular = ParseF32(&parser);
+			}
+			else if (strcmp(keyword, "plane") == 0)
+			{
+				world->planes = (Plane*)GrowArray(world->planes, &planeCapacity, world->planeCount, sizeof(Plane));
+				Plane* plane = &world->planes[world->planeCount++];
+				plane->normal = ParseVec3(&parser);
+				plane->dist = ParseF32(&parser);
+				plane->matIndex = ParseMaterialIndex(&parser, world);
+
+				// NOTE: the normal is also the shading normal, scaling it would scale the lighting
+				f32 length = VecLength(plane->normal);
+				if (parser.valid && !(length > 0.0f))
+				{
+					SceneError(&parser, "plane normal can't be zero");
+				}
+				plane->normal = Vec3(plane->normal.x / length, plane->normal.y / length, plane->normal.z / length);
+				plane->dist /= length;
+			}
+			else if (strcmp(keyword, "sphere") == 0)
+			{
+				world->spheres = (Sphere*)GrowArray(world->spheres, &sphereCapacity, world->sphereCount, sizeof(Sphere));
+				Sphere* sphere = &world->spheres[world->sphereCount++];
+				sphere->pos = ParseVec3(&parser);
+				sphere->radius = ParseF32(&parser);
+				sphere->matIndex = ParseMaterialIndex(&parser, world);
+				if (parser.valid && !(sphere->radius > 0.0f))
+				{
+					SceneError(&parser, "sphere radius must be positive");
+				}
+			}
+			else if (strcmp(keyword, "mesh") == 0)
+			{
+				char* meshFileName = ParseWord(&parser);
+				u32 matIndex = ParseMaterialIndex(&parser, world);
+				vec3 offset = {};
+				f32 scale = 1.0f;
+				if (*SkipSpaces(parser.at))
+				{
+					offset = ParseVec3(&parser);
+					scale = ParseF32(&parser);
+				}
+
+				if (parser.valid)
+				{
+					char path[4096];
+					const char* slash = strrchr(fileName, '/');
+					const char* backslash = strrchr(fileName, '\\');
+					if (backslash && (!slash || backslash > slash))
+					{
+						slash = backslash;
+					}
+					bool absolute = (meshFileName[0] == '/' || meshFileName[0] == '\\' || (meshFileName[0] && meshFileName[1] == ':'));
+					if (slash && !absolute)
+					{
+						snprintf(path, sizeof(path), "%.*s%s", (int)(slash - fileName + 1), fileName, meshFileName);
+					}
+					else
+					{
+						snprintf(path, sizeof(path), "%s", meshFileName);
+					}
+
+					if (!LoadOBJ(world, path, matIndex, offset, scale))
+					{
+						SceneError(&parser, "unable to load mesh");
+					}
+				}
+			}
+			else
+			{
+				SceneError(&parser, "unknown directive");
+			}
+
+			if (parser.valid && *SkipSpaces(parser.at))
+			{
+				SceneError(&parser, "unexpected trailing text");
+			}
+		}
+
+		at = next;
+		++parser.lineNumber;
+	}
+
+	if (parser.valid && world->materialCount == 0)
+	{
+		SceneError(&parser, "scene needs at least the sky material");
+	}
+
+	return parser.valid;
+}
+
+static bool LoadScene(Scene* scene, const char* fileName)
+{
+	EntireFile file = ReadEntireFile(fileName);
+	if (!file.contents)
+	{
+		fprintf(stderr, "[ERROR] Unable to read scene file %s.\n", fileName);
+		return false;
+	}
+
+	bool result = ParseScene(scene, file.contents, fileName);
+	free(file.contents);
+
+	return result;
+}
+
+// NOTE: the scene the renderer shipped with, used when no scene file is given
+static const char defaultSceneText[] =
+	"camera 0 -10 1  0 0 0\n"
+	"material 0.01 0.01 0.01  0 0 0  0\n"
+	"material 0 0 0  0.6 0.6 0.6  0\n"
+	"material 0 0 0  0.5 0.5 1  0\n"
+	"material 40 10 1  0 0 0  0\n"
+	"material 0 0 0  0.1 1 0.8  1\n"
+	"material 0 0 0  0.5 0.2 0.9  0.85\n"
+	"material 0 0 0  0.99 0.99 0.99  1\n"
+	"plane 0 0 1  0  1\n"
+	"sphere 0 -1 0  1  2\n"
+	"sphere 3 -2 0  1  3\n"
+	"sphere -2 -1 2  1  4\n"
+	"sphere 1 -1 2.5  1  5\n"
+	"sphere -3 5 0  3  6\n";
+
+static bool LoadDefaultScene(Scene* scene)
+{
+	char* text = CopyString(defaultSceneText);
+	bool result = ParseScene(scene, text, "<default scene>");
+	free(text);
+
+	return result;
+}
+
+// NOTE: acceleration structures and packed arrays, run once every primitive is in. The sphere leaves
+// are sized for the lane width of the kernel that renders it
+static void PrepareWorld(World* world, u32 laneWidth)
+{
+	BuildLightList(world);
+	BuildSphereBVH(world, laneWidth);
+	BuildTriangleBVH(world);
+	PackWorldSoA(world);
+}
+
+static Camera MakeCamera(vec3 pos, vec3 target, u32 imageWidth, u32 imageHeight)
+{
+	f32 filmDist = 1.0f;
+
+	Camera result;
+	result.pos = pos;
+	result.z = VecNormalize(pos - target);
+	result.x = VecNormalize(Cross(Vec3(0, 0, 1), result.z));
+	if (VecLengthSq(result.x) == 0.0f)
+	{
+		// NOTE: looking straight up or down, any horizontal axis will do
+		result.x = VecNormalize(Cross(Vec3(0, 1, 0), result.z));
+	}
+	result.y = VecNormalize(Cross(result.z, result.x));
+	result.filmCenter = pos - filmDist * result.z;
+
+	result.filmW = 1.0f;
+	result.filmH = 1.0f;
+	if (imageWidth > imageHeight)
+	{
+		result.filmH = result.filmW * ((f32)imageHeight / (f32)imageWidth);
+	}
+	else if (imageHeight > imageWidth)
+	{
+		result.filmW = result.filmH * ((f32)imageWidth / (f32)imageHeight);
+	}
+
+	return result;
+}
+
+#endif
@@ -0,0 +1,382 @@
+#if !defined RAY_SUITE_H
+# define RAY_SUITE_H
+
+//
+// Benchmark scene suite
+//
+// Procedural scenes at fixed seeds, sizes and sample counts, so throughput can be compared
+// across builds. Every scene is generated in memory and needs no files. Results are written
+// as JSON, and a previous results file can be given as a baseline to flag regressions.
+//
+
+#define SUITE_IMAGE_WIDTH 640
+#define SUITE_IMAGE_HEIGHT 360
+#define SUITE_RAYS_PER_PIXEL 16
+#define SUITE_MAX_BOUNCE_COUNT 8
+// NOTE: percent of baseline rays/s a scene may lose before it counts as a regression
+#define SUITE_DEFAULT_TOLERANCE 10.0
+
+// NOTE: xorshift, only the scene layout depends on it, never the kernels
+static u32 NextSuiteRandom(u32* state)
+{
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
+
+static f32 SuiteRandomRange(u32* state, f32 min, f32 max)
+{
+	f32 t = (f32)(NextSuiteRandom(state) >> 8) / (f32)(1 << 24);
+	f32 result = min + t * (max - min);
+
+	return result;
+}
+
+static u32 AddSuiteMaterial(World* world, vec3 emitColor, vec3 reflectColor, f32 specular)
+{
+	u32 result = world->materialCount++;
+	world->materials = (Material*)realloc(world->materials, sizeof(Material) * world->materialCount);
+	world->materials[result].emitColor = emitColor;
+	world->materials[result].reflectColor = reflectColor;
+	world->materials[result].specular = specular;
+
+	return result;
+}
+
+static void AddSuitePlane(World* world, vec3 normal, f32 dist, u32 matIndex)
+{
+	u32 index = world->planeCount++;
+	world->planes = (Plane*)realloc(world->planes, sizeof(Plane) * world->planeCount);
+	world->planes[index].normal = normal;
+	world->planes[index].dist = dist;
+	world->planes[index].matIndex = matIndex;
+}
+
+// NOTE: the sky, a grey ground plane and a handful of diffuse / glossy colours shared by the generators
+static void AddSuiteBasics(World* world, u32* state, u32 paletteCount)
+{
+	AddSuiteMaterial(world, Vec3(0.3f, 0.4f, 0.5f), Vec3(0, 0, 0), 0.0f);
+	u32 groundMaterial = AddSuiteMaterial(world, Vec3(0, 0, 0), Vec3(0.5f, 0.5f, 0.5f), 0.0f);
+	AddSuitePlane(world, Vec3(0, 0, 1), 0.0f, groundMaterial);
+
+	for (u32 paletteIndex = 0; paletteIndex < paletteCount; ++paletteIndex)
+	{
+		vec3 color = Vec3(SuiteRandomRange(state, 0.2f, 0.9f), SuiteRandomRange(state, 0.2f, 0.9f), SuiteRandomRange(state, 0.2f, 0.9f));
+		AddSuiteMaterial(world, Vec3(0, 0, 0), color, SuiteRandomRange(state, 0.0f, 0.8f));
+	}
+}
+
+// NOTE: scatters small spheres resting on the ground over a square field
+static void AddSuiteSpheres(World* world, u32* state, u32 count, f32 fieldSize, f32 minRadius, f32 maxRadius,
+	u32 firstMaterial, u32 materialCount)
+{
+	u32 first = world->sphereCount;
+	world->sphereCount += count;
+	world->spheres = (Sphere*)realloc(world->spheres, sizeof(Sphere) * world->sphereCount);
+	for (u32 sphereIndex = first; sphereIndex < world->sphereCount; ++sphereIndex)
+	{
+		Sphere* sphere = &world->spheres[sphereIndex];
+		sphere->radius = SuiteRandomRange(state, minRadius, maxRadius);
+		sphere->pos.x = SuiteRandomRange(state, -fieldSize, fieldSize);
+		sphere->pos.y = SuiteRandomRange(state, -fieldSize, fieldSize);
+		sphere->pos.z = sphere->radius + SuiteRandomRange(state, 0.0f, 2.0f * maxRadius);
+		sphere->matIndex = firstMaterial + NextSuiteRandom(state) % materialCount;
+	}
+}
+
+static void GenerateLargeSpheres(Scene* scene, u32 seed)
+{
+	World* world = &scene->world;
+	u32 state = seed;
+	AddSuiteBasics(world, &state, 6);
+	AddSuiteMaterial(world, Vec3(20.0f, 10.0f, 2.0f), Vec3(0, 0, 0), 0.0f);
+	AddSuiteSpheres(world, &state, 8, 6.0f, 1.0f, 3.0f, 2, 7);
+
+	scene->cameraPos = Vec3(0, -20, 5);
+	scene->cameraTarget = Vec3(0, 0, 1);
+}
+
+static void GenerateSmallSpheres(Scene* scene, u32 seed, u32 count)
+{
+	World* world = &scene->world;
+	u32 state = seed;
+	AddSuiteBasics(world, &state, 12);
+	AddSuiteMaterial(world, Vec3(8.0f, 6.0f, 4.0f), Vec3(0, 0, 0), 0.0f);
+
+	// NOTE: density stays about the same as the count grows, so the camera sees a similar depth of field
+	f32 fieldSize = 2.0f * sqrtf((f32)count);
+	AddSuiteSpheres(world, &state, count, fieldSize, 0.3f, 1.0f, 2, 13);
+
+	scene->cameraPos = Vec3(0, -fieldSize, 0.15f * fieldSize);
+	scene->cameraTarget = Vec3(0, 0, 0);
+}
+
+static void GenerateSpheres10K(Scene* scene, u32 seed)
+{
+	GenerateSmallSpheres(scene, seed, 10000);
+}
+
+static void GenerateSpheres100K(Scene* scene, u32 seed)
+{
+	GenerateSmallSpheres(scene, seed, 100000);
+}
+
+static void GenerateSpheres1M(Scene* scene, u32 seed)
+{
+	GenerateSmallSpheres(scene, seed, 1000000);
+}
+
+// NOTE: nearly every path runs to the bounce limit
+static void GenerateMirrors(Scene* scene, u32 seed)
+{
+	World* world = &scene->world;
+	u32 state = seed;
+	AddSuiteBasics(world, &state, 0);
+	u32 firstMirror = world->materialCount;
+	AddSuiteMaterial(world, Vec3(0, 0, 0), Vec3(0.95f, 0.95f, 0.95f), 1.0f);
+	AddSuiteMaterial(world, Vec3(0, 0, 0), Vec3(0.9f, 0.7f, 0.5f), 1.0f);
+	AddSuiteMaterial(world, Vec3(0, 0, 0), Vec3(0.6f, 0.8f, 0.9f), 0.95f);
+	u32 emitter = AddSuiteMaterial(world, Vec3(30.0f, 30.0f, 30.0f), Vec3(0, 0, 0), 0.0f);
+	AddSuiteSpheres(world, &state, 64, 8.0f, 0.5f, 1.5f, firstMirror, 3);
+	AddSuiteSpheres(world, &state, 4, 8.0f, 0.5f, 1.0f, emitter, 1);
+
+	scene->cameraPos = Vec3(0, -16, 4);
+	scene->cameraTarget = Vec3(0, 0, 1);
+}
+
+// NOTE: dark sky, light only comes from hundreds of small emitters
+static void GenerateEmitters(Scene* scene, u32 seed)
+{
+	World* world = &scene->world;
+	u32 state = seed;
+	AddSuiteMaterial(world, Vec3(0.01f, 0.01f, 0.01f), Vec3(0, 0, 0), 0.0f);
+	u32 groundMaterial = AddSuiteMaterial(world, Vec3(0, 0, 0), Vec3(0.6f, 0.6f, 0.6f), 0.0f);
+	AddSuitePlane(world, Vec3(0, 0, 1), 0.0f, groundMaterial);
+
+	u32 firstEmitter = world->materialCount;
+	for (u32 emitterIndex = 0; emitterIndex < 8; ++emitterIndex)
+	{
+		vec3 color = Vec3(SuiteRandomRange(&state, 1.0f, 20.0f), SuiteRandomRange(&state, 1.0f, 20.0f), SuiteRandomRange(&state, 1.0f, 20.0f));
+		AddSuiteMaterial(world, color, Vec3(0, 0, 0), 0.0f);
+	}
+	AddSuiteSpheres(world, &state, 500, 20.0f, 0.1f, 0.4f, firstEmitter, 8);
+	AddSuiteSpheres(world, &state, 200, 20.0f, 0.5f, 1.5f, groundMaterial, 1);
+
+	scene->cameraPos = Vec3(0, -30, 6);
+	scene->cameraTarget = Vec3(0, 0, 0);
+}
+
+// NOTE: planes aren't in the BVH, every one of them is tested against every ray
+static void GeneratePlanes(Scene* scene, u32 seed)
+{
+	World* world = &scene->world;
+	u32 state = seed;
+	AddSuiteBasics(world, &state, 8);
+
+	// NOTE: planes tilted away from the camera, stacked behind the spheres
+	for (u32 planeIndex = 0; planeIndex < 32; ++planeIndex)
+	{
+		vec3 normal = Vec3(SuiteRandomRange(&state, -0.3f, 0.3f), SuiteRandomRange(&state, -1.0f, -0.5f), SuiteRandomRange(&state, -0.3f, 0.3f));
+		f32 dist = SuiteRandomRange(&state, 10.0f, 60.0f);
+		AddSuitePlane(world, VecNormalize(normal), dist, 2 + NextSuiteRandom(&state) % 8);
+	}
+	AddSuiteSpheres(world, &state, 32, 8.0f, 0.5f, 1.5f, 2, 8);
+
+	scene->cameraPos = Vec3(0, -20, 4);
+	scene->cameraTarget = Vec3(0, 0, 1);
+}
+
+typedef void GenerateSuiteSceneFn(Scene* scene, u32 seed);
+
+struct SuiteScene
+{
+	const char* name;
+	GenerateSuiteSceneFn* generate;
+	u32 seed;
+};
+
+static SuiteScene suiteScenes[] =
+{
+	{ "large-spheres", GenerateLargeSpheres, 0x1234567 },
+	{ "spheres-10k", GenerateSpheres10K, 0x2345678 },
+	{ "spheres-100k", GenerateSpheres100K, 0x3456789 },
+	{ "spheres-1m", GenerateSpheres1M, 0x456789A },
+	{ "mirrors", GenerateMirrors, 0x56789AB },
+	{ "emitters", GenerateEmitters, 0x6789ABC },
+	{ "planes", GeneratePlanes, 0x789ABCD },
+};
+
+static void GenerateSuiteScene(Scene* scene, SuiteScene* suiteScene)
+{
+	InitScene(scene);
+	scene->imageWidth = SUITE_IMAGE_WIDTH;
+	scene->imageHeight = SUITE_IMAGE_HEIGHT;
+	scene->raysPerPixel = SUITE_RAYS_PER_PIXEL;
+	scene->maxBounceCount = SUITE_MAX_BOUNCE_COUNT;
+	suiteScene->generate(scene, suiteScene->seed);
+}
+
+// NOTE: one scene's entry in a results file written by WriteSuiteResults, start is 0 if it's missing
+struct BaselineScene
+{
+	char* start;
+	char* end;
+};
+
+static BaselineScene FindBaselineScene(char* baseline, const char* sceneName)
+{
+	char key[256];
+	snprintf(key, sizeof(key), "\"scene\": \"%s\"", sceneName);
+
+	BaselineScene result = {};
+	result.start = strstr(baseline, key);
+	if (result.start)
+	{
+		result.end = strstr(result.start + 1, "\"scene\":");
+		if (!result.end)
+		{
+			result.end = result.start + strlen(result.start);
+		}
+	}
+
+	return result;
+}
+
+// NOTE: text is matched as WriteBenchmarkJSON formats it
+static char* FindInBaselineScene(BaselineScene* scene, const char* text)
+{
+	char* result = strstr(scene->start, text);
+	if (result && result >= scene->end)
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
+static f64 GetBaselineRaysPerSecond(BaselineScene* scene)
+{
+	f64 result = 0.0;
+	char* rays = FindInBaselineScene(scene, "\"raysPerSecond\":");
+	char* median = rays ? strstr(rays, "\"median\":") : 0;
+	if (median && median < scene->end)
+	{
+		result = strtod(median + strlen("\"median\":"), 0);
+	}
+
+	return result;
+}
+
+// NOTE: rays/s only compare between runs of the same kernel, thread count, sampler and mode, false if
+// any scene of the baseline was recorded with other settings than this run
+static bool CheckSuiteBaseline(BenchmarkResult* results, u32 resultCount, char* baseline, const char* baselineFileName)
+{
+	const char* settingNames[] = { "kernel", "lane width", "thread count", "sampler", "wavefront mode" };
+	bool settingDiffers[ARRAY_COUNT(settingNames)] = {};
+	for (u32 resultIndex = 0; resultIndex < resultCount; ++resultIndex)
+	{
+		BenchmarkResult* current = &results[resultIndex];
+		BaselineScene scene = FindBaselineScene(baseline, current->sceneName);
+		if (!scene.start)
+		{
+			continue;
+		}
+
+		char settings[ARRAY_COUNT(settingNames)][128];
+		snprintf(settings[0], sizeof(settings[0]), "\"kernel\": \"%s\"", current->kernelName);
+		snprintf(settings[1], sizeof(settings[1]), "\"laneWidth\": %u,", current->laneWidth);
+		snprintf(settings[2], sizeof(settings[2]), "\"threads\": %u,", current->threadCount);
+		snprintf(settings[3], sizeof(settings[3]), "\"sampler\": \"%s\"", GetSamplerName(current->samplerKind));
+		snprintf(settings[4], sizeof(settings[4]), "\"wavefront\": %s,", current->wavefront ? "true" : "false");
+		for (u32 settingIndex = 0; settingIndex < ARRAY_COUNT(settings); ++settingIndex)
+		{
+			if (!FindInBaselineScene(&scene, settings[settingIndex]))
+			{
+				settingDiffers[settingIndex] = true;
+			}
+		}
+	}
+
+	bool result = true;
+	for (u32 settingIndex = 0; settingIndex < ARRAY_COUNT(settingNames); ++settingIndex)
+	{
+		if (settingDiffers[settingIndex])
+		{
+			fprintf(stderr, "[ERROR] Baseline %s was recorded with a different %s than this run.\n",
+				baselineFileName, settingNames[settingIndex]);
+			result = false;
+		}
+	}
+	if (!result)
+	{
+		fprintf(stderr, "[ERROR] Not comparing against it, record a baseline with the same settings.\n");
+	}
+
+	return result;
+}
+
+static bool WriteSuiteResults(BenchmarkResult* results, u32 resultCount, const char* fileName)
+{
+	FILE* file = fopen(fileName, "w");
+	if (!file)
+	{
+		fprintf(stderr, "[ERROR] Unable to write benchmark results %s.\n", fileName);
+		return false;
+	}
+
+	fprintf(file, "[\n");
+	for (u32 resultIndex = 0; resultIndex < resultCount; ++resultIndex)
+	{
+		if (resultIndex)
+		{
+			fprintf(file, ",\n");
+		}
+		WriteBenchmarkJSON(file, &results[resultIndex]);
+	}
+	fprintf(file, "]\n");
+	fclose(file);
+
+	return true;
+}
+
+// NOTE: returns the number of regressions, scenes missing from the baseline are only reported
+static u32 CompareSuiteResults(BenchmarkResult* results, u32 resultCount, char* baseline, f64 tolerance)
+{
+	u32 result = 0;
+
+	printf("\n%-16s %10s %10s %8s\n", "scene", "Mrays/s", "baseline", "change");
+	for (u32 resultIndex = 0; resultIndex < resultCount; ++resultIndex)
+	{
+		BenchmarkResult* current = &results[resultIndex];
+		f64 raysPerSecond = current->raysPerSecond.median;
+		f64 baselineRaysPerSecond = 0.0;
+		if (baseline)
+		{
+			BaselineScene scene = FindBaselineScene(baseline, current->sceneName);
+			baselineRaysPerSecond = scene.start ? GetBaselineRaysPerSecond(&scene) : 0.0;
+		}
+		if (baselineRaysPerSecond > 0.0)
+		{
+			f64 change = 100.0 * (raysPerSecond / baselineRaysPerSecond - 1.0);
+			bool regression = (change < -tolerance);
+			printf("%-16s %10.2f %10.2f %+7.1f%%%s\n", current->sceneName, 1e-6 * raysPerSecond,
+				1e-6 * baselineRaysPerSecond, change, regression ? "  REGRESSION" : "");
+			if (regression)
+			{
+				++result;
+			}
+		}
+		else
+		{
+			printf("%-16s %10.2f %10s %8s\n", current->sceneName, 1e-6 * raysPerSecond, "-", "-");
+		}
+	}
+
+	return result;
+}
+
+#endif
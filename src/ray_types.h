@@ -0,0 +1,33 @@
+#if !defined RAY_TYPES_H
+# define RAY_TYPES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <math.h>
+#include <float.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+typedef int8_t i8;
+typedef int16_t i16;
+typedef int32_t i32;
+typedef int64_t i64;
+
+typedef float f32;
+typedef double f64;
+
+#define U32_MAX ((u32) - 1)
+
+struct vec3
+{
+	float x, y, z;
+};
+
+#endif
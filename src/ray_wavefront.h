@@ -0,0 +1,349 @@
+#if !defined RAY_WAVEFRONT_H
+# define RAY_WAVEFRONT_H
+
+//
+// Wavefront kernel
+//
+// The per-pixel kernel traces a lane of one pixel's samples to the end, and lanes whose paths ended
+// ride along idle until the last one does. Here a block of pixels is cast as one wave of rays, bounce
+// by bounce, every bounce in two passes over the whole stream: intersection, then shading. Each pass
+// writes the rays that go on packed into the other buffer straight from the lanes, so lane groups stay
+// full, and the intersection pass sorts them by the kind of surface they hit, so diffuse and glossy
+// bounces are shaded in groups of their own. The samples are the ones the per-pixel kernel draws.
+//
+
+static lane_v3 LoadLaneV3(f32* x, f32* y, f32* z, u32 index)
+{
+	lane_v3 result = LaneV3(LoadLaneF32(x + index), LoadLaneF32(y + index), LoadLaneF32(z + index));
+	return result;
+}
+
+static void StoreLaneV3(f32* x, f32* y, f32* z, u32 index, lane_v3 value)
+{
+	StoreLaneF32(x + index, value.x);
+	StoreLaneF32(y + index, value.y);
+	StoreLaneF32(z + index, value.z);
+}
+
+// NOTE: lanes from end on are masked off, whatever a previous wave left there
+static PathLanes LoadPathLanes(RayStreamSoA* rays, u32 index, u32 end, u32 samplerKind, u32 pairIndex, lane_u32* pathIndex)
+{
+	PathLanes result;
+	result.rayOrigin = LoadLaneV3(rays->originX, rays->originY, rays->originZ, index);
+	result.rayDir = LoadLaneV3(rays->dirX, rays->dirY, rays->dirZ, index);
+	result.attenuation = LoadLaneV3(rays->attenuationX, rays->attenuationY, rays->attenuationZ, index);
+	result.sample = LoadLaneV3(rays->sampleX, rays->sampleY, rays->sampleZ, index);
+	result.laneMask = (LaneIndices() + LaneU32FromU32(index)) < LaneU32FromU32(end);
+	result.scatterMisMask = LoadLaneU32(rays->scatterMisMask + index);
+	result.scatterPdf = LoadLaneF32(rays->scatterPdf + index);
+
+	result.sampler.kind = samplerKind;
+	result.sampler.pixelSeed = LoadLaneU32(rays->pixelSeed + index);
+	result.sampler.reversedSampleIndex = LoadLaneU32(rays->reversedSampleIndex + index);
+	result.sampler.pairIndex = pairIndex;
+	result.sampler.series.state = LoadLaneU32(rays->randomState + index);
+
+	*pathIndex = LoadLaneU32(rays->pathIndex + index);
+
+	return result;
+}
+
+// NOTE: masked off lanes get material 0, so gathers through it stay inside the material table
+static PathHit LoadPathHit(RayStreamSoA* rays, u32 index, lane_u32 laneMask)
+{
+	PathHit result;
+	result.dist = LoadLaneF32(rays->hitDist + index);
+	result.material = LaneU32FromU32(0);
+	ConditionalAssign(&result.material, laneMask, LoadLaneU32(rays->hitMaterial + index));
+	result.normal = LoadLaneV3(rays->normalX, rays->normalY, rays->normalZ, index);
+
+	return result;
+}
+
+// NOTE: the lanes of mask packed to the front and written at index, a whole lane at a time, which is
+// why every region of a ray stream is padded past its capacity. The hit is left out when there's none
+static u32 AppendPathLanes(RayStreamSoA* rays, u32 index, lane_u32 mask, PathLanes* path, lane_u32 pathIndex, PathHit* hit)
+{
+	lane_u32 indices = CompressIndices(mask);
+	StoreLaneV3(rays->originX, rays->originY, rays->originZ, index, PermuteLanes(path->rayOrigin, indices));
+	StoreLaneV3(rays->dirX, rays->dirY, rays->dirZ, index, PermuteLanes(path->rayDir, indices));
+	StoreLaneV3(rays->attenuationX, rays->attenuationY, rays->attenuationZ, index, PermuteLanes(path->attenuation, indices));
+	StoreLaneV3(rays->sampleX, rays->sampleY, rays->sampleZ, index, PermuteLanes(path->sample, indices));
+	StoreLaneU32(rays->scatterMisMask + index, PermuteLanes(path->scatterMisMask, indices));
+	StoreLaneF32(rays->scatterPdf + index, PermuteLanes(path->scatterPdf, indices));
+
+	StoreLaneU32(rays->pixelSeed + index, PermuteLanes(path->sampler.pixelSeed, indices));
+	StoreLaneU32(rays->reversedSampleIndex + index, PermuteLanes(path->sampler.reversedSampleIndex, indices));
+	StoreLaneU32(rays->randomState + index, PermuteLanes(path->sampler.series.state, indices));
+
+	StoreLaneU32(rays->pathIndex + index, PermuteLanes(pathIndex, indices));
+
+	if (hit)
+	{
+		StoreLaneF32(rays->hitDist + index, PermuteLanes(hit->dist, indices));
+		StoreLaneU32(rays->hitMaterial + index, PermuteLanes(hit->material, indices));
+		StoreLaneV3(rays->normalX, rays->normalY, rays->normalZ, index, PermuteLanes(hit->normal, indices));
+	}
+
+	u32 result = MaskLaneCount(mask);
+	return result;
+}
+
+// NOTE: the lanes of endedMask leave the light their paths gathered with the paths
+static void FinishPathLanes(RayStream* stream, PathLanes* path, lane_u32 pathIndex, lane_u32 endedMask)
+{
+	u32 bits = MaskBits(endedMask);
+	for (u32 laneIndex = 0; laneIndex < LANE_WIDTH; ++laneIndex)
+	{
+		if (bits & (1u << laneIndex))
+		{
+			stream->pathColor[ExtractLane(pathIndex, laneIndex)] = ExtractLane(path->sample, laneIndex);
+		}
+	}
+}
+
+// NOTE: every ray of the stream against the world and the light it found there. The rays that go on
+// are written to the two regions of sorted, diffuse surfaces in the first and glossy ones in the second.
+// A packet is passed for the camera rays only
+static void IntersectStage(World* world, RayPacket* packet, RayStream* stream, u32 rayCount, u32 samplerKind, u32 pairIndex,
+	u32* diffuseCount, u32* glossyCount)
+{
+	RayStreamSoA* rays = &stream->rays;
+	RayStreamSoA* sorted = &stream->sorted;
+	u32 glossyRegion = stream->regionSize;
+
+	for (u32 base = 0; base < rayCount; base += LANE_WIDTH)
+	{
+		lane_u32 pathIndex;
+		PathLanes path = LoadPathLanes(rays, base, rayCount, samplerKind, pairIndex, &pathIndex);
+		lane_u32 validMask = path.laneMask;
+
+		PathHit hit;
+		hit.dist = LaneF32FromF32(FLT_MAX);
+		hit.material = LaneU32FromU32(0);
+		hit.normal = Vec3(0.0f);
+		if (packet)
+		{
+			IntersectCameraRays(world, packet, path.rayOrigin, path.rayDir, path.laneMask, &hit.dist, &hit.material, &hit.normal);
+		}
+		else
+		{
+			IntersectWorld(world, path.rayOrigin, path.rayDir, path.laneMask, &hit.dist, &hit.material, &hit.normal);
+		}
+
+		// NOTE: planes don't look at the lane mask
+		lane_u32 material = LaneU32FromU32(0);
+		ConditionalAssign(&material, validMask, hit.material);
+		hit.material = material;
+
+		AddHitEmission(world, &path, &hit);
+		FinishPathLanes(stream, &path, pathIndex, AndNot(path.laneMask, validMask));
+
+		if (!MaskIsZero(path.laneMask))
+		{
+			MaterialLookup lookup = LookupMaterials(hit.material, path.laneMask);
+			lane_f32 matSpecular = MaterialF32(&lookup, world->materialSoA.specular);
+			lane_u32 glossyMask = path.laneMask & (matSpecular > LaneF32FromF32(0.0f));
+			lane_u32 diffuseMask = AndNot(glossyMask, path.laneMask);
+			*diffuseCount += AppendPathLanes(sorted, *diffuseCount, diffuseMask, &path, pathIndex, &hit);
+			*glossyCount += AppendPathLanes(sorted, glossyRegion + *glossyCount, glossyMask, &path, pathIndex, &hit);
+		}
+	}
+}
+
+// NOTE: the rays of one region of sorted, scattered onward and appended to rays
+static void ShadeStage(World* world, RayStream* stream, u32 region, u32 regionRayCount, u32 samplerKind, u32 pairIndex,
+	u32 bounce, u32 maxBounceCount, u32 rouletteStartBounce, u32* rayCount, u32* nextPairIndex)
+{
+	RayStreamSoA* rays = &stream->rays;
+	RayStreamSoA* sorted = &stream->sorted;
+
+	u32 end = region + regionRayCount;
+	for (u32 base = region; base < end; base += LANE_WIDTH)
+	{
+		lane_u32 pathIndex;
+		PathLanes path = LoadPathLanes(sorted, base, end, samplerKind, pairIndex, &pathIndex);
+		lane_u32 validMask = path.laneMask;
+		PathHit hit = LoadPathHit(sorted, base, validMask);
+
+		ScatterPath(world, &path, &hit, bounce, maxBounceCount, rouletteStartBounce);
+		*nextPairIndex = path.sampler.pairIndex;
+
+		FinishPathLanes(stream, &path, pathIndex, AndNot(path.laneMask, validMask));
+		*rayCount += AppendPathLanes(rays, *rayCount, path.laneMask, &path, pathIndex, 0);
+	}
+}
+
+static void TraceWave(World* world, RayStream* stream, u32 rayCount, u32 pairIndex, CastState* cast)
+{
+	u64 bounceCount = 0;
+	u64 laneSlots = 0;
+
+	for (u32 bounce = 0; bounce < cast->maxBounceCount && rayCount > 0; ++bounce)
+	{
+		bounceCount += rayCount;
+		laneSlots += (rayCount + LANE_WIDTH - 1) / LANE_WIDTH * LANE_WIDTH;
+
+		u32 diffuseCount = 0;
+		u32 glossyCount = 0;
+		RayPacket* packet = (bounce == 0) ? cast->packet : 0;
+		IntersectStage(world, packet, stream, rayCount, cast->samplerKind, pairIndex, &diffuseCount, &glossyCount);
+
+		// NOTE: every path is at the same sampler dimension, whichever region gets there first
+		u32 nextPairIndex = pairIndex;
+		rayCount = 0;
+		ShadeStage(world, stream, 0, diffuseCount, cast->samplerKind, pairIndex,
+			bounce, cast->maxBounceCount, cast->rouletteStartBounce, &rayCount, &nextPairIndex);
+		ShadeStage(world, stream, stream->regionSize, glossyCount, cast->samplerKind, pairIndex,
+			bounce, cast->maxBounceCount, cast->rouletteStartBounce, &rayCount, &nextPairIndex);
+		pairIndex = nextPairIndex;
+	}
+
+	RayStreamSoA* rays = &stream->rays;
+	for (u32 rayIndex = 0; rayIndex < rayCount; ++rayIndex)
+	{
+		vec3* color = &stream->pathColor[rays->pathIndex[rayIndex]];
+		color->x = rays->sampleX[rayIndex];
+		color->y = rays->sampleY[rayIndex];
+		color->z = rays->sampleZ[rayIndex];
+	}
+
+	cast->bouncesComputed += bounceCount;
+	cast->laneSlotsComputed += laneSlots;
+}
+
+static void CastBlockRays(CastState* cast)
+{
+	World* world = cast->world;
+	RayStream* stream = cast->stream;
+	lane_v3 filmCenter = LaneV3FromV3(cast->filmCenter);
+	lane_f32 filmW = LaneF32FromF32(cast->filmW);
+	lane_f32 filmH = LaneF32FromF32(cast->filmH);
+	lane_f32 halfPixW = LaneF32FromF32(cast->halfPixW);
+	lane_f32 halfPixH = LaneF32FromF32(cast->halfPixH);
+	lane_v3 cameraX = LaneV3FromV3(cast->cameraX);
+	lane_v3 cameraY = LaneV3FromV3(cast->cameraY);
+	lane_v3 cameraPos = LaneV3FromV3(cast->cameraPos);
+
+	u32 blockWidth = cast->blockMaxX - cast->blockMinX;
+	u32 blockPixelCount = blockWidth * (cast->blockMaxY - cast->blockMinY);
+	assert(blockPixelCount * LANE_WIDTH <= stream->capacity);
+
+	u32 laneRayCount = cast->raysPerPixel / LANE_WIDTH;
+	assert(laneRayCount * LANE_WIDTH == cast->raysPerPixel);
+
+	// NOTE: the same stopping rule as the per-pixel kernel, checked after every lane batch past the minimum
+	// on the statistics of every pass so far. Pixels it stopped in an earlier pass aren't cast at all
+	f32 adaptiveThreshold = cast->adaptiveThreshold;
+	u32 minRayCount = (cast->minRaysPerPixel > 2) ? cast->minRaysPerPixel : 2;
+
+	u32 activePixelCount = 0;
+	for (u32 pixelSlot = 0; pixelSlot < blockPixelCount; ++pixelSlot)
+	{
+		if (!stream->converged[pixelSlot])
+		{
+			stream->activePixels[activePixelCount++] = pixelSlot;
+		}
+		stream->pixelColor[pixelSlot] = {};
+		stream->pixelRayCount[pixelSlot] = 0;
+	}
+
+	// NOTE: a wave takes as many lane batches per pixel as fit, only one when adaptive sampling has to
+	// see every batch before it decides on the next
+	u32 roundsPerWave = 1;
+	if (adaptiveThreshold <= 0.0f && stream->capacity / (blockPixelCount * LANE_WIDTH) > 1)
+	{
+		roundsPerWave = stream->capacity / (blockPixelCount * LANE_WIDTH);
+	}
+
+	u32 rayIndex = 0;
+	while (rayIndex < laneRayCount && activePixelCount > 0)
+	{
+		u32 waveRounds = MinU32(roundsPerWave, laneRayCount - rayIndex);
+		u32 waveRayCount = 0;
+		u32 pairIndex = 0;
+		for (u32 round = 0; round < waveRounds; ++round)
+		{
+			for (u32 activeIndex = 0; activeIndex < activePixelCount; ++activeIndex)
+			{
+				u32 pixelSlot = stream->activePixels[activeIndex];
+				u32 x = cast->blockMinX + pixelSlot % blockWidth;
+				u32 y = cast->blockMinY + pixelSlot / blockWidth;
+				f32 filmX = -1.0f + 2.0f * ((f32)x / (f32)cast->imageWidth);
+				f32 filmY = -1.0f + 2.0f * ((f32)y / (f32)cast->imageHeight);
+				u32 pixelIndex = (u32)(x + (u64)y * cast->imageWidth);
+
+				Sampler sampler = StartSample(cast->samplerKind, pixelIndex, cast->firstSampleIndex + (rayIndex + round) * LANE_WIDTH);
+
+				lane_f32 jitterX, jitterY;
+				Sample2D(&sampler, &jitterX, &jitterY);
+				lane_f32 offX = LaneF32FromF32(filmX + cast->halfPixW) + halfPixW * (2.0f * jitterX - 1.0f);
+				lane_f32 offY = LaneF32FromF32(filmY + cast->halfPixH) + halfPixH * (2.0f * jitterY - 1.0f);
+				lane_v3 filmPos = filmCenter + offX * 0.5f * filmW * cameraX + offY * 0.5f * filmH * cameraY;
+
+				PathLanes path = StartPath(sampler, cameraPos, VecNormalize(filmPos - cameraPos));
+				lane_u32 pathIndex = LaneU32FromU32(waveRayCount) + LaneIndices();
+				StoreLaneU32(stream->pathPixel + waveRayCount, LaneU32FromU32(pixelSlot));
+				waveRayCount += AppendPathLanes(&stream->rays, waveRayCount, path.laneMask, &path, pathIndex, 0);
+				pairIndex = path.sampler.pairIndex;
+			}
+		}
+
+		TraceWave(world, stream, waveRayCount, pairIndex, cast);
+
+		for (u32 pathIndex = 0; pathIndex < waveRayCount; ++pathIndex)
+		{
+			u32 pixelSlot = stream->pathPixel[pathIndex];
+			vec3 color = stream->pathColor[pathIndex];
+			f32 luminance = 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+			stream->pixelColor[pixelSlot].x += color.x;
+			stream->pixelColor[pixelSlot].y += color.y;
+			stream->pixelColor[pixelSlot].z += color.z;
+			stream->luminanceSum[pixelSlot] += luminance;
+			stream->luminanceSqSum[pixelSlot] += luminance * luminance;
+		}
+		rayIndex += waveRounds;
+
+		u32 stillActiveCount = 0;
+		for (u32 activeIndex = 0; activeIndex < activePixelCount; ++activeIndex)
+		{
+			u32 pixelSlot = stream->activePixels[activeIndex];
+			stream->pixelRayCount[pixelSlot] += waveRounds * LANE_WIDTH;
+
+			bool converged = false;
+			u32 pixelRayCount = stream->priorRayCount[pixelSlot] + stream->pixelRayCount[pixelSlot];
+			if (adaptiveThreshold > 0.0f && pixelRayCount >= minRayCount)
+			{
+				f32 n = (f32)pixelRayCount;
+				f32 sum = stream->luminanceSum[pixelSlot];
+				f32 mean = sum / n;
+				f32 variance = MaxF32((stream->luminanceSqSum[pixelSlot] - sum * mean) / (n - 1.0f), 0.0f);
+				converged = (variance <= Square(adaptiveThreshold * (mean + ADAPTIVE_ERROR_FLOOR)) * n);
+			}
+			stream->converged[pixelSlot] = converged;
+			if (!converged)
+			{
+				stream->activePixels[stillActiveCount++] = pixelSlot;
+			}
+		}
+		activePixelCount = stillActiveCount;
+	}
+
+	u32 rayCount = 0;
+	for (u32 pixelSlot = 0; pixelSlot < blockPixelCount; ++pixelSlot)
+	{
+		u32 pixelRayCount = stream->pixelRayCount[pixelSlot];
+		if (pixelRayCount == 0)
+		{
+			continue;
+		}
+		f32 invRayCount = 1.0f / (f32)pixelRayCount;
+		stream->pixelColor[pixelSlot].x *= invRayCount;
+		stream->pixelColor[pixelSlot].y *= invRayCount;
+		stream->pixelColor[pixelSlot].z *= invRayCount;
+		rayCount += pixelRayCount;
+	}
+	cast->raysCast = rayCount;
+}
+
+#endif
@@ -2,21 +2,39 @@
 # define RAY_WIN32
 
 #include <windows.h>
+#include <io.h>
 
-static bool RenderTile(WorkQueue* queue);
+// NOTE: WaitOnAddress / WakeByAddressAll
+#pragma comment(lib, "Synchronization.lib")
+
+typedef HANDLE ThreadHandle;
+
+static bool RenderTile(WorkQueue* queue, u32 threadIndex);
 
 static DWORD WINAPI ThreadProc(void* lpParameter)
 {
-	WorkQueue* queue = (WorkQueue*)lpParameter;
-	while (RenderTile(queue)) {};
+	WorkThread* thread = (WorkThread*)lpParameter;
+	while (RenderTile(thread->queue, thread->threadIndex)) {};
 	return 0;
 }
 
-static void CreateThread(void* parametr)
+static bool CreateThread(ThreadHandle* thread, void* parametr)
 {
 	DWORD threadID;
-	HANDLE handle = CreateThread(NULL, 0, ThreadProc, parametr, 0, &threadID);
-	CloseHandle(handle);
+	*thread = CreateThread(NULL, 0, ThreadProc, parametr, 0, &threadID);
+	bool result = (*thread != NULL);
+	if (!result)
+	{
+		fprintf(stderr, "[ERROR] Unable to create worker thread.\n");
+	}
+
+	return result;
+}
+
+static void JoinThread(ThreadHandle thread)
+{
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
 }
 
 static u32 GetCpuCoreCount()
@@ -28,6 +46,61 @@ static u32 GetCpuCoreCount()
 	return result;
 }
 
+static void* AllocateAligned(size_t size, size_t alignment)
+{
+	void* result = _aligned_malloc(size, alignment);
+
+	return result;
+}
+
+static void FreeAligned(void* memory)
+{
+	_aligned_free(memory);
+}
+
+static MappedFile MapEntireFile(const char* fileName)
+{
+	MappedFile result = {};
+
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		{
+			HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping)
+			{
+				void* contents = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				if (contents)
+				{
+					result.size = (size_t)size.QuadPart;
+					result.contents = contents;
+				}
+				// NOTE: the view keeps the mapping alive
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+	}
+
+	return result;
+}
+
+static void UnmapEntireFile(MappedFile* file)
+{
+	UnmapViewOfFile(file->contents);
+	*file = {};
+}
+
+// NOTE: long is 32 bits even on x64, ftell fails past 2 GB
+static i64 GetFilePosition(FILE* file)
+{
+	i64 result = _ftelli64(file);
+
+	return result;
+}
+
 static u64 LockedAdd(u64 volatile* value, u64 a)
 {
 	u64 result = InterlockedExchangeAdd64((volatile LONG64*)value, a);
@@ -35,4 +108,58 @@ static u64 LockedAdd(u64 volatile* value, u64 a)
 	return result;
 }
 
+static u32 AtomicCompareExchange(u32 volatile* value, u32 newValue, u32 expected)
+{
+	u32 result = (u32)InterlockedCompareExchange((volatile LONG*)value, (LONG)newValue, (LONG)expected);
+
+	return result;
+}
+
+// NOTE: sleeps while *value == expected, returns on a wake, a spurious wakeup or the timeout
+static void WaitOnValue(u32 volatile* value, u32 expected, u32 timeoutMs)
+{
+	WaitOnAddress(value, &expected, sizeof(u32), timeoutMs);
+}
+
+static void WakeAllWaiters(u32 volatile* value)
+{
+	WakeByAddressAll((void*)value);
+}
+
+static f64 GetWallClockSeconds()
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	f64 result = (f64)counter.QuadPart / (f64)frequency.QuadPart;
+
+	return result;
+}
+
+static void YieldThread()
+{
+	SwitchToThread();
+}
+
+static void CpuRelax()
+{
+	YieldProcessor();
+}
+
+// NOTE: through the C library's buffer and the system cache, so the contents survive a crash of the host
+static bool SyncFile(FILE* file)
+{
+	bool result = (fflush(file) == 0 && FlushFileBuffers((HANDLE)_get_osfhandle(_fileno(file))) != 0);
+
+	return result;
+}
+
+static bool ReplaceFileWith(const char* fileName, const char* newFileName)
+{
+	bool result = (MoveFileExA(newFileName, fileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0);
+
+	return result;
+}
+
 #endif
\ No newline at end of file
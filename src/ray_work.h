@@ -0,0 +1,219 @@
+#if !defined RAY_WORK_H
+# define RAY_WORK_H
+
+//
+// Work stealing tile scheduler
+//
+// Every thread owns a deque of tiles, seeded with a contiguous run of the image. A thread that
+// runs dry steals the oldest tile of another thread, and whoever takes the last tile of its own
+// deque splits it and leaves half behind, so tiles shrink towards the end of a frame and the
+// slow ones get shared instead of holding up the whole frame.
+//
+
+#define TILE_SIZE 64
+// NOTE: tiles split down to blocks, also how often a budgeted frame looks at the clock
+#define TILE_BLOCK_SIZE 16
+
+static void LockDeque(TileDeque* deque)
+{
+	while (AtomicCompareExchange(&deque->lock, 1, 0) != 0)
+	{
+		CpuRelax();
+	}
+}
+
+static void UnlockDeque(TileDeque* deque)
+{
+	AtomicCompareExchange(&deque->lock, 0, 1);
+}
+
+// NOTE: the caller holds the lock
+static void PushWorkOrder(TileDeque* deque, WorkOrder order)
+{
+	assert(deque->bottom - deque->top < deque->capacity);
+	deque->orders[deque->bottom % deque->capacity] = order;
+	++deque->bottom;
+}
+
+// NOTE: halves the longer side on a block boundary, false once the order is a single block
+static bool SplitWorkOrder(WorkOrder* order, WorkOrder* rest)
+{
+	u32 blocksX = (order->maxX - order->minX + TILE_BLOCK_SIZE - 1) / TILE_BLOCK_SIZE;
+	u32 blocksY = (order->maxY - order->minY + TILE_BLOCK_SIZE - 1) / TILE_BLOCK_SIZE;
+
+	bool result = false;
+	*rest = *order;
+	if (blocksX >= blocksY && blocksX > 1)
+	{
+		u32 splitX = order->minX + (blocksX / 2) * TILE_BLOCK_SIZE;
+		order->maxX = splitX;
+		rest->minX = splitX;
+		result = true;
+	}
+	else if (blocksY > 1)
+	{
+		u32 splitY = order->minY + (blocksY / 2) * TILE_BLOCK_SIZE;
+		order->maxY = splitY;
+		rest->minY = splitY;
+		result = true;
+	}
+
+	return result;
+}
+
+static bool PopWorkOrder(WorkQueue* queue, TileDeque* deque, WorkOrder* order)
+{
+	LockDeque(deque);
+	bool result = (deque->top != deque->bottom);
+	if (result)
+	{
+		--deque->bottom;
+		*order = deque->orders[deque->bottom % deque->capacity];
+
+		WorkOrder rest;
+		if (deque->top == deque->bottom && SplitWorkOrder(order, &rest))
+		{
+			// NOTE: counted before the popped order is released so the pending count can't touch zero early
+			PushWorkOrder(deque, rest);
+			LockedAdd(&queue->pendingOrderCount, 1);
+		}
+	}
+	UnlockDeque(deque);
+
+	if (result)
+	{
+		LockedAdd(&queue->pendingOrderCount, (u64)-1);
+	}
+
+	return result;
+}
+
+// NOTE: moves the oldest order of the first non-empty victim into the thief's own deque
+static bool StealWorkOrder(WorkQueue* queue, u32 threadIndex)
+{
+	bool result = false;
+	for (u32 offset = 1; offset < queue->threadCount && !result; ++offset)
+	{
+		TileDeque* victim = &queue->deques[(threadIndex + offset) % queue->threadCount];
+		if (victim->top == victim->bottom)
+		{
+			continue;
+		}
+
+		WorkOrder order;
+		LockDeque(victim);
+		result = (victim->top != victim->bottom);
+		if (result)
+		{
+			order = victim->orders[victim->top % victim->capacity];
+			++victim->top;
+		}
+		UnlockDeque(victim);
+
+		if (result)
+		{
+			TileDeque* own = &queue->deques[threadIndex];
+			LockDeque(own);
+			PushWorkOrder(own, order);
+			UnlockDeque(own);
+		}
+	}
+
+	return result;
+}
+
+// NOTE: false once every order has been handed out
+static bool GetNextWorkOrder(WorkQueue* queue, u32 threadIndex, WorkOrder* order)
+{
+	TileDeque* own = &queue->deques[threadIndex];
+	for (;;)
+	{
+		if (PopWorkOrder(queue, own, order))
+		{
+			return true;
+		}
+		if (!StealWorkOrder(queue, threadIndex))
+		{
+			if (queue->pendingOrderCount == 0)
+			{
+				return false;
+			}
+			// NOTE: another thief has the remaining orders in flight between deques, give it the core
+			YieldThread();
+		}
+	}
+}
+
+static u32 GetTileCount(ImageU32 image)
+{
+	u32 result = ((image.width + TILE_SIZE - 1) / TILE_SIZE) * ((image.height + TILE_SIZE - 1) / TILE_SIZE);
+	return result;
+}
+
+static void InitWorkQueue(WorkQueue* queue, u32 threadCount)
+{
+	ImageU32 image = queue->image;
+
+	// NOTE: a deque never holds more orders than there are blocks, whatever the splits and steals
+	u32 blockCount = ((image.width + TILE_BLOCK_SIZE - 1) / TILE_BLOCK_SIZE) *
+		((image.height + TILE_BLOCK_SIZE - 1) / TILE_BLOCK_SIZE);
+
+	queue->threadCount = threadCount;
+	queue->deques = (TileDeque*)malloc(sizeof(TileDeque) * threadCount);
+	queue->threadStats = (WorkThreadStats*)AllocateAligned(sizeof(WorkThreadStats) * threadCount, sizeof(WorkThreadStats));
+	for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+	{
+		TileDeque* deque = &queue->deques[threadIndex];
+		deque->lock = 0;
+		deque->capacity = blockCount;
+		deque->orders = (WorkOrder*)malloc(sizeof(WorkOrder) * blockCount);
+	}
+}
+
+static void FreeWorkQueue(WorkQueue* queue)
+{
+	for (u32 threadIndex = 0; threadIndex < queue->threadCount; ++threadIndex)
+	{
+		free(queue->deques[threadIndex].orders);
+	}
+	free(queue->deques);
+	FreeAligned(queue->threadStats);
+	queue->deques = 0;
+	queue->threadStats = 0;
+}
+
+// NOTE: tiles in raster order, thread i gets the i-th contiguous run
+static void ResetWorkQueue(WorkQueue* queue)
+{
+	ImageU32 image = queue->image;
+	u32 tileCountX = (image.width + TILE_SIZE - 1) / TILE_SIZE;
+	u32 tileTotal = GetTileCount(image);
+
+	u32 threadCount = queue->threadCount;
+	for (u32 threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+	{
+		TileDeque* deque = &queue->deques[threadIndex];
+		deque->top = 0;
+		deque->bottom = 0;
+		memset(&queue->threadStats[threadIndex], 0, sizeof(WorkThreadStats));
+
+		// NOTE: pushed back to front so the owner pops its run in raster order and thieves start at the far end
+		u32 firstTile = (u32)((u64)tileTotal * threadIndex / threadCount);
+		u32 onePastLastTile = (u32)((u64)tileTotal * (threadIndex + 1) / threadCount);
+		for (u32 tileIndex = onePastLastTile; tileIndex > firstTile; --tileIndex)
+		{
+			u32 tileX = (tileIndex - 1) % tileCountX;
+			u32 tileY = (tileIndex - 1) / tileCountX;
+
+			WorkOrder order;
+			order.minX = tileX * TILE_SIZE;
+			order.maxX = MinU32(order.minX + TILE_SIZE, image.width);
+			order.minY = tileY * TILE_SIZE;
+			order.maxY = MinU32(order.minY + TILE_SIZE, image.height);
+			PushWorkOrder(deque, order);
+		}
+	}
+	queue->pendingOrderCount = tileTotal;
+}
+
+#endif
@@ -0,0 +1,253 @@
+#if !defined RAY_WORLD_H
+# define RAY_WORLD_H
+
+//
+// Scene preparation
+//
+
+struct EntireFile
+{
+	size_t size;
+	char* contents; // NOTE: null terminated
+};
+
+static EntireFile ReadEntireFile(const char* fileName)
+{
+	EntireFile result = {};
+
+	// NOTE: an empty result on any failure, the callers report it as a file they couldn't read
+	FILE* file = fopen(fileName, "rb");
+	if (file)
+	{
+		i64 size = -1;
+		if (fseek(file, 0, SEEK_END) == 0)
+		{
+			size = GetFilePosition(file);
+		}
+		if (size >= 0 && (u64)size < SIZE_MAX && fseek(file, 0, SEEK_SET) == 0)
+		{
+			result.contents = (char*)malloc((size_t)size + 1);
+			if (result.contents)
+			{
+				result.size = fread(result.contents, 1, (size_t)size, file);
+				result.contents[result.size] = 0;
+			}
+		}
+		fclose(file);
+	}
+
+	return result;
+}
+
+static char* SkipSpaces(char* at)
+{
+	while (*at == ' ' || *at == '\t')
+	{
+		++at;
+	}
+
+	return at;
+}
+
+static char* NextLine(char* at)
+{
+	while (*at && *at != '\n')
+	{
+		++at;
+	}
+	if (*at == '\n')
+	{
+		++at;
+	}
+
+	return at;
+}
+
+static bool IsLineEnd(char c)
+{
+	bool result = (c == 0 || c == '\n' || c == '\r' || c == '#');
+	return result;
+}
+
+static u32 GetPaddedPrimCount(u32 count)
+{
+	u32 result = ((count + MAX_LANE_WIDTH - 1) / MAX_LANE_WIDTH + 1) * MAX_LANE_WIDTH;
+	return result;
+}
+
+static size_t GetWorldSoASize(World* world)
+{
+	size_t result = sizeof(u32) * (5 * (GetPaddedPrimCount(world->sphereCount) + GetPaddedPrimCount(world->planeCount)) +
+		8 * GetPaddedPrimCount(world->materialCount));
+	return result;
+}
+
+// NOTE: points the packed arrays into one block of GetWorldSoASize bytes
+static void BindWorldSoA(World* world, u32* block)
+{
+	u32 sphereStride = GetPaddedPrimCount(world->sphereCount);
+	u32 planeStride = GetPaddedPrimCount(world->planeCount);
+
+	SphereSoA* spheres = &world->sphereSoA;
+	spheres->x = (f32*)(block + 0 * sphereStride);
+	spheres->y = (f32*)(block + 1 * sphereStride);
+	spheres->z = (f32*)(block + 2 * sphereStride);
+	spheres->radius = (f32*)(block + 3 * sphereStride);
+	spheres->matIndex = block + 4 * sphereStride;
+
+	block += 5 * sphereStride;
+	PlaneSoA* planes = &world->planeSoA;
+	planes->nx = (f32*)(block + 0 * planeStride);
+	planes->ny = (f32*)(block + 1 * planeStride);
+	planes->nz = (f32*)(block + 2 * planeStride);
+	planes->dist = (f32*)(block + 3 * planeStride);
+	planes->matIndex = block + 4 * planeStride;
+
+	block += 5 * planeStride;
+	u32 materialStride = GetPaddedPrimCount(world->materialCount);
+	MaterialSoA* materials = &world->materialSoA;
+	materials->emitR = (f32*)(block + 0 * materialStride);
+	materials->emitG = (f32*)(block + 1 * materialStride);
+	materials->emitB = (f32*)(block + 2 * materialStride);
+	materials->reflectR = (f32*)(block + 3 * materialStride);
+	materials->reflectG = (f32*)(block + 4 * materialStride);
+	materials->reflectB = (f32*)(block + 5 * materialStride);
+	materials->specular = (f32*)(block + 6 * materialStride);
+	materials->lightIndex = block + 7 * materialStride;
+}
+
+// NOTE: emissive spheres become the light list, each with its own copy of its material, so the kernel
+// can tell from the material of a hit which light a bounce ray found. Runs before BuildSphereBVH, so the
+// lights keep the scene's order whatever leaves the BVH is built with and a light pick draws the same
+// light at every lane width, and before PackWorldSoA copies the sphere materials
+static void BuildLightList(World* world)
+{
+	for (u32 matIndex = 0; matIndex < world->materialCount; ++matIndex)
+	{
+		world->materials[matIndex].lightIndex = LIGHT_NONE;
+	}
+
+	u32 lightCount = 0;
+	for (u32 sphereIndex = 0; sphereIndex < world->sphereCount; ++sphereIndex)
+	{
+		Sphere* sphere = &world->spheres[sphereIndex];
+		vec3 emitColor = world->materials[sphere->matIndex].emitColor;
+		if (sphere->matIndex != 0 && sphere->radius > 0.0f && MaxF32(MaxF32(emitColor.x, emitColor.y), emitColor.z) > 0.0f)
+		{
+			++lightCount;
+		}
+	}
+
+	world->lightCount = lightCount;
+	world->lights = 0;
+	if (lightCount == 0)
+	{
+		return;
+	}
+
+	world->lights = (Light*)malloc(sizeof(Light) * lightCount);
+	world->materials = (Material*)realloc(world->materials, sizeof(Material) * (world->materialCount + lightCount));
+
+	f32 totalPower = 0.0f;
+	u32 lightIndex = 0;
+	for (u32 sphereIndex = 0; sphereIndex < world->sphereCount; ++sphereIndex)
+	{
+		Sphere* sphere = &world->spheres[sphereIndex];
+		Material* material = &world->materials[sphere->matIndex];
+		vec3 emitColor = material->emitColor;
+		if (sphere->matIndex != 0 && sphere->radius > 0.0f && MaxF32(MaxF32(emitColor.x, emitColor.y), emitColor.z) > 0.0f)
+		{
+			Material* copy = &world->materials[world->materialCount];
+			*copy = *material;
+			copy->lightIndex = lightIndex;
+			sphere->matIndex = world->materialCount++;
+
+			// NOTE: power up to constants, luminance times surface area
+			Light* light = &world->lights[lightIndex++];
+			light->pos = sphere->pos;
+			light->radius = sphere->radius;
+			light->emitColor = emitColor;
+			light->pickProbability = (0.2126f * emitColor.x + 0.7152f * emitColor.y + 0.0722f * emitColor.z) * Square(sphere->radius);
+			totalPower += light->pickProbability;
+		}
+	}
+
+	f32 pickCDF = 0.0f;
+	for (lightIndex = 0; lightIndex < lightCount; ++lightIndex)
+	{
+		Light* light = &world->lights[lightIndex];
+		if (totalPower > 0.0f)
+		{
+			light->pickProbability /= totalPower;
+		}
+		else
+		{
+			light->pickProbability = 1.0f / (f32)lightCount;
+		}
+		light->pickCDF = pickCDF;
+		pickCDF += light->pickProbability;
+	}
+}
+
+// NOTE: only for a world built in memory, a cached one points into its mapped file
+static void FreeWorld(World* world)
+{
+	free(world->materials);
+	free(world->planes);
+	free(world->spheres);
+	free(world->vertices);
+	free(world->triangles);
+	free(world->lights);
+	free(world->sphereBVH.nodes);
+	free(world->triangleBVH.nodes);
+	FreeAligned(world->sphereSoA.x); // NOTE: the start of the block every packed array lives in
+	*world = {};
+}
+
+// NOTE: the packed arrays follow the spheres array, so this runs after BuildSphereBVH reordered it, and
+// the materials, so after BuildLightList added the lights' copies
+static void PackWorldSoA(World* world)
+{
+	size_t size = GetWorldSoASize(world);
+	u32* block = (u32*)AllocateAligned(size, sizeof(u32) * MAX_LANE_WIDTH);
+	memset(block, 0, size);
+	BindWorldSoA(world, block);
+
+	SphereSoA* spheres = &world->sphereSoA;
+	for (u32 sphereIndex = 0; sphereIndex < world->sphereCount; ++sphereIndex)
+	{
+		Sphere* sphere = &world->spheres[sphereIndex];
+		spheres->x[sphereIndex] = sphere->pos.x;
+		spheres->y[sphereIndex] = sphere->pos.y;
+		spheres->z[sphereIndex] = sphere->pos.z;
+		spheres->radius[sphereIndex] = sphere->radius;
+		spheres->matIndex[sphereIndex] = sphere->matIndex;
+	}
+
+	PlaneSoA* planes = &world->planeSoA;
+	for (u32 planeIndex = 0; planeIndex < world->planeCount; ++planeIndex)
+	{
+		Plane* plane = &world->planes[planeIndex];
+		planes->nx[planeIndex] = plane->normal.x;
+		planes->ny[planeIndex] = plane->normal.y;
+		planes->nz[planeIndex] = plane->normal.z;
+		planes->dist[planeIndex] = plane->dist;
+		planes->matIndex[planeIndex] = plane->matIndex;
+	}
+
+	MaterialSoA* materials = &world->materialSoA;
+	for (u32 matIndex = 0; matIndex < world->materialCount; ++matIndex)
+	{
+		Material* material = &world->materials[matIndex];
+		materials->emitR[matIndex] = material->emitColor.x;
+		materials->emitG[matIndex] = material->emitColor.y;
+		materials->emitB[matIndex] = material->emitColor.z;
+		materials->reflectR[matIndex] = material->reflectColor.x;
+		materials->reflectG[matIndex] = material->reflectColor.y;
+		materials->reflectB[matIndex] = material->reflectColor.z;
+		materials->specular[matIndex] = material->specular;
+		materials->lightIndex[matIndex] = material->lightIndex;
+	}
+}
+
+#endif